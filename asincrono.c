@@ -0,0 +1,511 @@
+// Pablo Araújo Rodríguez   pablo.araujo@udc.es
+// Uriel Liñares Vaamonde   uriel.linaresv@udc.es
+
+#define _GNU_SOURCE
+#include <errno.h>
+#include <limits.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include "asincrono.h"
+#include "contenedores.h"
+#include "hilos.h"
+#include "uring.h"
+
+// La E/S bloquea sin gastar CPU: no depende del número de procesadores
+#define AIO_THREADS 4
+// Por operación; el kernel recorta cada read/write a algo menos de 2 GiB
+#define AIO_CHUNK (1u << 30)
+// Al salir, tiempo que se espera a las peticiones ya canceladas
+#define AIO_EXIT_GRACE_MS 2000
+// await mira cada tanto si llegó Ctrl-C; tras cancelar, espera esto como mucho
+#define AIO_POLL_MS 100
+#define AIO_CANCEL_GRACE_MS 500
+// user_data de las cancelaciones (los identificadores son positivos)
+#define AIO_CANCEL_UD UINT64_MAX
+
+typedef struct {
+    int id;
+    aio_op_t op;
+    int fd;
+    bool own_fd;
+    bool full;
+    char *buf;
+    size_t len;
+    long long off;          // -1: posición actual del descriptor
+    size_t done;            // bytes ya transferidos
+    int err;
+    bool finished;
+    bool cancelled;         // no se vuelve a encolar
+    struct timespec t0, t1;
+    char *desc;
+} tAioReq;
+
+typedef enum { BK_URING, BK_POOL } aio_backend_t;
+
+static pthread_mutex_t aio_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t aio_cv = PTHREAD_COND_INITIALIZER;
+static bool aio_ready = false;
+static pid_t aio_owner;
+static aio_backend_t aio_backend;
+static tVector aio_reqs;            // tAioReq*, por identificador creciente
+static int aio_next_id = 1;
+static size_t aio_inflight = 0;
+static bool aio_stopping = false;   // al salir: nada se vuelve a encolar
+static volatile sig_atomic_t aio_sigint = 0;
+static tUring aio_ring;
+static bool aio_ring_up = false;    // anillo y recolector arrancados
+static pthread_t aio_reaper;
+static tExecutor *aio_pool = NULL;
+
+// Instante absoluto (CLOCK_REALTIME, el de pthread_cond_timedwait) dentro de ms
+static struct timespec deadline_in(long ms) {
+    struct timespec t;
+    clock_gettime(CLOCK_REALTIME, &t);
+    t.tv_sec += ms / 1000;
+    t.tv_nsec += (ms % 1000) * 1000000L;
+    if (t.tv_nsec >= 1000000000L) { t.tv_sec++; t.tv_nsec -= 1000000000L; }
+    return t;
+}
+
+static double elapsed_ms(const struct timespec *a, const struct timespec *b) {
+    return (double)(b->tv_sec - a->tv_sec) * 1e3 +
+           (double)(b->tv_nsec - a->tv_nsec) / 1e6;
+}
+
+static tAioReq *req_at(size_t i) {
+    return *(tAioReq **)vector_at(&aio_reqs, i);
+}
+
+// Búsqueda binaria: los identificadores se añaden en orden
+static size_t req_index(int id) {
+    size_t lo = 0, hi = aio_reqs.len;
+    while (lo < hi) {
+        size_t mid = lo + (hi - lo) / 2;
+        if (req_at(mid)->id < id) lo = mid + 1;
+        else hi = mid;
+    }
+    return lo < aio_reqs.len && req_at(lo)->id == id ? lo : SIZE_MAX;
+}
+
+static void req_remove(size_t i) {
+    tAioReq *r = req_at(i);
+    memmove(aio_reqs.data + i * sizeof r, aio_reqs.data + (i + 1) * sizeof r,
+            (aio_reqs.len - i - 1) * sizeof r);
+    aio_reqs.len--;
+    free(r->desc);
+    free(r);
+}
+
+// Con aio_lock tomado
+static void req_complete(tAioReq *r) {
+    clock_gettime(CLOCK_MONOTONIC, &r->t1);
+    if (r->own_fd) close(r->fd);
+    r->finished = true;
+    aio_inflight--;
+    pthread_cond_broadcast(&aio_cv);
+}
+
+/* -------------------------- io_uring -------------------------- */
+
+#if URING_AVAILABLE
+// Prepara y publica la siguiente operación de r; con aio_lock tomado
+static int req_prep(tAioReq *r) {
+    struct io_uring_sqe *sqe = uring_get_sqe(&aio_ring);
+    if (!sqe) { errno = EAGAIN; return -1; }
+    size_t n = r->len - r->done;
+    if (n > AIO_CHUNK) n = AIO_CHUNK;
+    sqe->opcode = r->op == AIO_READ ? IORING_OP_READ : IORING_OP_WRITE;
+    sqe->fd = r->fd;
+    sqe->addr = (uint64_t)(uintptr_t)(r->buf + r->done);
+    sqe->len = (unsigned)n;
+    sqe->off = r->off < 0 ? (uint64_t)-1 : (uint64_t)r->off + r->done;
+    // Por identificador: una finalización tardía nunca toca memoria liberada
+    sqe->user_data = (unsigned)r->id;
+    return uring_submit(&aio_ring, 0) < 0 ? -1 : 0;
+}
+
+// Las que siguen en el anillo fallan con err (el anillo ya no sirve)
+static void fail_pending(int err) {
+    for (size_t i = 0; i < aio_reqs.len; ++i) {
+        tAioReq *r = req_at(i);
+        if (!r->finished) { r->err = err; req_complete(r); }
+    }
+}
+
+/* Recolector: espera finalizaciones sin tocar el anillo de envío, así que
+ * no retiene aio_lock mientras duerme. Una lectura completa que se queda
+ * corta (sin llegar a EOF) se vuelve a encolar desde donde iba. Termina al
+ * recibir la operación vacía de user_data 0. */
+static void *reaper_main(void *arg) {
+    (void)arg;
+    for (bool stop = false; !stop;) {
+        int rc = uring_wait(&aio_ring, 1);
+        pthread_mutex_lock(&aio_lock);
+        if (rc < 0) {
+            fail_pending(errno);
+            aio_backend = BK_POOL;      // lo nuevo, al grupo de hilos
+            pthread_mutex_unlock(&aio_lock);
+            return NULL;
+        }
+        struct io_uring_cqe *cqe;
+        while ((cqe = uring_peek_cqe(&aio_ring))) {
+            uint64_t ud = cqe->user_data;
+            int res = cqe->res;
+            uring_cqe_seen(&aio_ring);
+            if (ud == 0) { stop = true; continue; }
+            if (ud == AIO_CANCEL_UD) continue;
+            size_t i = req_index((int)ud);
+            tAioReq *r = i == SIZE_MAX ? NULL : req_at(i);
+            if (!r || r->finished) continue;
+            bool again = !aio_stopping && !r->cancelled;
+            if ((res == -EINTR || res == -EAGAIN) && again) {
+                if (req_prep(r) == 0) continue;
+                r->err = errno;
+            } else if (res < 0) {
+                r->err = -res;
+            } else {
+                r->done += (size_t)res;
+                if (r->full && res > 0 && r->done < r->len && again) {
+                    if (req_prep(r) == 0) continue;
+                    r->err = errno;
+                }
+            }
+            req_complete(r);
+        }
+        pthread_mutex_unlock(&aio_lock);
+    }
+    return NULL;
+}
+
+static bool uring_start(void) {
+    if (uring_init(&aio_ring, AIO_MAX_INFLIGHT) != 0) return false;
+    // Sin posición actual (kernels < 5.6) read fd no tendría sentido
+    if (!(aio_ring.features & IORING_FEAT_RW_CUR_POS) ||
+        pthread_create(&aio_reaper, NULL, reaper_main, NULL) != 0) {
+        uring_free(&aio_ring);
+        return false;
+    }
+    return true;
+}
+
+// Pide al kernel que cancele r (sin enviarlo aún); con aio_lock tomado
+static void uring_prep_cancel(tAioReq *r) {
+    r->cancelled = true;
+    struct io_uring_sqe *sqe = uring_get_sqe(&aio_ring);
+    if (!sqe) return;
+    sqe->opcode = IORING_OP_ASYNC_CANCEL;
+    sqe->addr = (unsigned)r->id;
+    sqe->user_data = AIO_CANCEL_UD;
+}
+
+static void uring_cancel(tAioReq *r) {
+    uring_prep_cancel(r);
+    uring_submit(&aio_ring, 0);
+}
+
+static void uring_cancel_all(void) {
+    for (size_t i = 0; i < aio_reqs.len; ++i)
+        if (!req_at(i)->finished) uring_prep_cancel(req_at(i));
+    uring_submit(&aio_ring, 0);
+}
+
+static void uring_stop(void) {
+    pthread_mutex_lock(&aio_lock);
+    struct io_uring_sqe *sqe = uring_get_sqe(&aio_ring);
+    if (sqe) {
+        sqe->opcode = IORING_OP_NOP;
+        sqe->user_data = 0;
+        uring_submit(&aio_ring, 0);
+    }
+    pthread_mutex_unlock(&aio_lock);
+    // Si el recolector ya salió por un error, el NOP no hace falta
+    pthread_join(aio_reaper, NULL);
+    uring_free(&aio_ring);
+}
+#else
+static int req_prep(tAioReq *r) { (void)r; errno = ENOSYS; return -1; }
+static void uring_cancel(tAioReq *r) { (void)r; }
+static void uring_cancel_all(void) {}
+static bool uring_start(void) { return false; }
+static void uring_stop(void) {}
+#endif
+
+/* ------------------------ grupo de hilos ------------------------ */
+
+static void pool_run(void *arg) {
+    tAioReq *r = arg;
+    // Hasta terminar, done y err solo los toca esta tarea
+    while (r->done < r->len || r->len == 0) {
+        size_t n = r->len - r->done;
+        if (n > AIO_CHUNK) n = AIO_CHUNK;
+        char *p = r->buf + r->done;
+        off_t at = (off_t)(r->off + (long long)r->done);
+        ssize_t k;
+        if (r->op == AIO_READ)
+            k = r->off < 0 ? read(r->fd, p, n) : pread(r->fd, p, n, at);
+        else
+            k = r->off < 0 ? write(r->fd, p, n) : pwrite(r->fd, p, n, at);
+        if (k < 0) {
+            if (errno == EINTR) continue;
+            r->err = errno;
+            break;
+        }
+        r->done += (size_t)k;
+        if (!r->full || k == 0) break;
+    }
+    pthread_mutex_lock(&aio_lock);
+    req_complete(r);
+    pthread_mutex_unlock(&aio_lock);
+}
+
+/* --------------------------- peticiones --------------------------- */
+
+static int ensure_init(void) {
+    if (aio_ready) return 0;
+    if (uring_start()) {
+        aio_ring_up = true;
+        aio_backend = BK_URING;
+    } else {
+        aio_pool = executor_create(AIO_THREADS);
+        if (!aio_pool) { errno = ENOMEM; return -1; }
+        aio_backend = BK_POOL;
+    }
+    vector_init(&aio_reqs, sizeof(tAioReq *));
+    aio_owner = getpid();
+    aio_ready = true;
+    return 0;
+}
+
+int aio_submit(aio_op_t op, int fd, bool own_fd, bool full, void *buf,
+               size_t len, long long off, const char *desc) {
+    pthread_mutex_lock(&aio_lock);
+    if (ensure_init() != 0) goto fail;
+    if (aio_inflight >= AIO_MAX_INFLIGHT) { errno = EAGAIN; goto fail; }
+    // El grupo de hilos se crea tarde si io_uring dejó de funcionar
+    if (aio_backend == BK_POOL && !aio_pool &&
+        !(aio_pool = executor_create(AIO_THREADS))) {
+        errno = ENOMEM;
+        goto fail;
+    }
+    // Sin await nunca se olvidarían: se descartan las terminadas más antiguas
+    for (size_t i = 0; aio_reqs.len - aio_inflight >= AIO_MAX_UNREPORTED;)
+        if (req_at(i)->finished) req_remove(i);
+        else ++i;
+    tAioReq *r = calloc(1, sizeof *r);
+    char *d = strdup(desc);
+    if (!r || !d || !vector_push(&aio_reqs, &r)) {
+        free(r);
+        free(d);
+        errno = ENOMEM;
+        goto fail;
+    }
+    r->id = aio_next_id++;
+    r->op = op;
+    r->fd = fd;
+    r->own_fd = own_fd;
+    r->full = full;
+    r->buf = buf;
+    r->len = len;
+    r->off = off;
+    r->desc = d;
+    clock_gettime(CLOCK_MONOTONIC, &r->t0);
+    int rc = aio_backend == BK_URING ? req_prep(r)
+                                     : executor_submit(aio_pool, pool_run, r);
+    if (rc != 0) {
+        int e = aio_backend == BK_URING ? errno : ENOMEM;
+        r->own_fd = false;      // el descriptor sigue siendo de quien llama
+        req_remove(aio_reqs.len - 1);
+        errno = e;
+        goto fail;
+    }
+    aio_inflight++;
+    int id = r->id;
+    pthread_mutex_unlock(&aio_lock);
+    return id;
+fail:
+    pthread_mutex_unlock(&aio_lock);
+    return -1;
+}
+
+bool aio_busy_region(const void *addr, size_t len) {
+    uintptr_t a = (uintptr_t)addr, b = a + len;
+    bool busy = false;
+    pthread_mutex_lock(&aio_lock);
+    for (size_t i = 0; aio_ready && i < aio_reqs.len && !busy; ++i) {
+        const tAioReq *r = req_at(i);
+        uintptr_t s = (uintptr_t)r->buf, e = s + r->len;
+        busy = !r->finished && s < b && a < e;
+    }
+    pthread_mutex_unlock(&aio_lock);
+    return busy;
+}
+
+bool aio_busy_fd(int fd) {
+    bool busy = false;
+    pthread_mutex_lock(&aio_lock);
+    for (size_t i = 0; aio_ready && i < aio_reqs.len && !busy; ++i) {
+        const tAioReq *r = req_at(i);
+        busy = !r->finished && !r->own_fd && r->fd == fd;
+    }
+    pthread_mutex_unlock(&aio_lock);
+    return busy;
+}
+
+bool aio_shutdown(void) {
+    pthread_mutex_lock(&aio_lock);
+    // En un hijo de fork() no hay recolector ni hilos que esperar
+    if (!aio_ready || getpid() != aio_owner) {
+        pthread_mutex_unlock(&aio_lock);
+        return true;
+    }
+    /* Una lectura de una tubería vacía no termina nunca: se cancela lo que
+     * se pueda y, si aun así algo sigue en curso (una tarea bloqueada en el
+     * grupo de hilos), no se desmonta nada; el proceso va a terminar */
+    aio_stopping = true;
+    if (aio_inflight > 0 && aio_ring_up) uring_cancel_all();
+    struct timespec limit = deadline_in(AIO_EXIT_GRACE_MS);
+    while (aio_inflight > 0 &&
+           pthread_cond_timedwait(&aio_cv, &aio_lock, &limit) == 0) {}
+    if (aio_inflight > 0) {
+        fprintf(stderr, "aio: %zu request(s) still in flight at exit\n",
+                aio_inflight);
+        pthread_mutex_unlock(&aio_lock);
+        return false;
+    }
+    pthread_mutex_unlock(&aio_lock);
+    // Si io_uring falló, puede haber grupo de hilos además del recolector
+    if (aio_ring_up) uring_stop();
+    aio_ring_up = false;
+    executor_destroy(aio_pool);
+    aio_pool = NULL;
+    while (aio_reqs.len) req_remove(aio_reqs.len - 1);
+    vector_free(&aio_reqs);
+    aio_stopping = false;
+    aio_ready = false;
+    return true;
+}
+
+/* ---------------------------- comandos ---------------------------- */
+
+void aio_interrupt(void) { aio_sigint = 1; }
+
+/* Espera a r con aio_lock tomado. Una lectura de una tubería vacía o de un
+ * terminal puede no acabar nunca: con Ctrl-C se cancela (io_uring) o, si
+ * la tiene un hilo bloqueado en read(), solo se deja de esperar. false si
+ * sigue en curso */
+static bool await_one(tAioReq *r) {
+    while (!r->finished && !aio_sigint) {
+        struct timespec t = deadline_in(AIO_POLL_MS);
+        pthread_cond_timedwait(&aio_cv, &aio_lock, &t);
+    }
+    if (r->finished) return true;
+    aio_sigint = 0;
+    if (aio_backend != BK_URING || !aio_ring_up) return false;
+    uring_cancel(r);
+    struct timespec t = deadline_in(AIO_CANCEL_GRACE_MS);
+    while (!r->finished && pthread_cond_timedwait(&aio_cv, &aio_lock, &t) == 0) {}
+    return r->finished;
+}
+
+static void print_abandoned(const tAioReq *r) {
+    printf("[%d] %s: still running, no longer awaited (see aio)\n", r->id,
+           r->desc);
+}
+
+static void print_result(const tAioReq *r) {
+    double ms = elapsed_ms(&r->t0, &r->t1);
+    if (r->err) {
+        printf("[%d] %s: %s after %.3f ms (%zu bytes)\n", r->id, r->desc,
+               strerror(r->err), ms, r->done);
+        return;
+    }
+    double mbs = ms > 0 ? (double)r->done / (ms * 1e3) : 0.0;
+    printf("[%d] %s: %zu/%zu bytes in %.3f ms (%.1f MB/s)\n", r->id, r->desc,
+           r->done, r->len, ms, mbs);
+}
+
+/* await [id]: espera a la petición id (o a todas, en orden), informa de
+ * su resultado y la olvida; con Ctrl-C deja de esperar (ver await_one) */
+int cmd_await(int argc, char *argv[]) {
+    if (argc > 2) { fprintf(stderr, "Usage: await [id]\n"); return 1; }
+    int id = 0;
+    if (argc == 2) {
+        char *end;
+        errno = 0;
+        long v = strtol(argv[1], &end, 10);
+        if (*argv[1] == '\0' || *end != '\0' || errno || v <= 0 ||
+            v > INT_MAX) {
+            fprintf(stderr, "await: invalid id '%s'\n", argv[1]);
+            return 1;
+        }
+        id = (int)v;
+    }
+    int status = 0;
+    aio_sigint = 0;     // un Ctrl-C anterior no cuenta
+    pthread_mutex_lock(&aio_lock);
+    if (id) {
+        size_t i = aio_ready ? req_index(id) : SIZE_MAX;
+        if (i == SIZE_MAX) {
+            pthread_mutex_unlock(&aio_lock);
+            fprintf(stderr, "await: no request %d\n", id);
+            return 1;
+        }
+        tAioReq *r = req_at(i);
+        if (!await_one(r)) {
+            print_abandoned(r);
+            pthread_mutex_unlock(&aio_lock);
+            return 1;
+        }
+        print_result(r);
+        status = r->err != 0;
+        req_remove(req_index(id));
+    } else if (!aio_ready || aio_reqs.len == 0) {
+        printf("No asynchronous requests\n");
+    } else {
+        while (aio_reqs.len) {
+            tAioReq *r = req_at(0);
+            if (!await_one(r)) {
+                print_abandoned(r);
+                status = 1;
+                break;
+            }
+            print_result(r);
+            if (r->err) status = 1;
+            req_remove(0);
+        }
+    }
+    pthread_mutex_unlock(&aio_lock);
+    return status;
+}
+
+// aio: peticiones en curso y terminadas aún sin await
+int cmd_aio(int argc, char *argv[]) {
+    (void)argv;
+    if (argc != 1) { fprintf(stderr, "Usage: aio\n"); return 1; }
+    pthread_mutex_lock(&aio_lock);
+    if (!aio_ready) {
+        pthread_mutex_unlock(&aio_lock);
+        printf("No asynchronous requests\n");
+        return 0;
+    }
+    printf("backend: %s, %zu in flight, %zu awaiting report\n",
+           aio_backend == BK_URING ? "io_uring" : "threads", aio_inflight,
+           aio_reqs.len - aio_inflight);
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    for (size_t i = 0; i < aio_reqs.len; ++i) {
+        const tAioReq *r = req_at(i);
+        if (r->finished) print_result(r);
+        else
+            printf("[%d] %s: pending for %.3f ms\n", r->id, r->desc,
+                   elapsed_ms(&r->t0, &now));
+    }
+    pthread_mutex_unlock(&aio_lock);
+    return 0;
+}
@@ -0,0 +1,46 @@
+// Pablo Araújo Rodríguez   pablo.araujo@udc.es
+// Uriel Liñares Vaamonde   uriel.linaresv@udc.es
+
+#ifndef ASINCRONO_H
+#define ASINCRONO_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+/* E/S asíncrona de la shell: cada petición (leer o escribir un bloque de
+ * memoria desde o hacia un descriptor) recibe un identificador y se
+ * completa en segundo plano. Con io_uring todas van a un anillo compartido
+ * y un hilo recolector recoge las finalizaciones; si no, cada petición es
+ * una tarea de un grupo de hilos. await y aio consultan los resultados. */
+
+typedef enum { AIO_READ, AIO_WRITE } aio_op_t;
+
+// Peticiones sin terminar a la vez (también el tamaño del anillo)
+#define AIO_MAX_INFLIGHT 256
+// Terminadas sin await que se conservan; después se olvidan las más antiguas
+#define AIO_MAX_UNREPORTED 1024
+
+/* Encola la petición; off < 0 usa (y avanza) la posición del descriptor.
+ * Con full se repite hasta len bytes o EOF; con own_fd el descriptor pasa
+ * a ser de la petición y se cierra al terminar (solo si se acepta). desc
+ * la describe en aio/await. Devuelve el identificador o -1 con errno
+ * (EAGAIN: demasiadas en curso). */
+int aio_submit(aio_op_t op, int fd, bool own_fd, bool full, void *buf,
+               size_t len, long long off, const char *desc);
+
+// Hay alguna petición sin terminar sobre [addr, addr + len) o sobre fd
+bool aio_busy_region(const void *addr, size_t len);
+bool aio_busy_fd(int fd);
+
+/* Cancela lo pendiente, espera un poco y libera el anillo o los hilos.
+ * false si algo sigue en curso: entonces no se ha liberado nada y sus
+ * bloques y descriptores tampoco deben liberarse */
+bool aio_shutdown(void);
+
+// Para el manejador de SIGINT: await deja de esperar (solo usa una bandera)
+void aio_interrupt(void);
+
+int cmd_await(int argc, char *argv[]);
+int cmd_aio(int argc, char *argv[]);
+
+#endif //ASINCRONO_H
@@ -0,0 +1,272 @@
+// Pablo Araújo Rodríguez   pablo.araujo@udc.es
+// Uriel Liñares Vaamonde   uriel.linaresv@udc.es
+
+/* Banco de pruebas de rendimiento (make bench).
+ * Mide cada subsistema del shell llamando directamente a sus funciones y
+ * escribe una línea CSV por medida en la salida estándar original:
+ *     subsystem,op,n,seconds,ops_per_sec
+ * La salida de los comandos se redirige a /dev/null. Cada medida es la mejor
+ * de BENCH_REPS repeticiones (una sola para los tamaños grandes). */
+
+#define _POSIX_C_SOURCE 200809L
+#include <errno.h>
+#include <fcntl.h>
+#include <stdint.h>
+#include <sys/stat.h>
+#include "comandos.h"
+
+#define BENCH_REPS 3
+
+static FILE *csv = NULL;
+static tArgs run_args;
+
+static double now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+}
+
+static void report(const char *subsystem, const char *op, size_t n,
+                   double secs) {
+    fflush(stdout);
+    fprintf(csv, "%s,%s,%zu,%.6f,%.1f\n", subsystem, op, n, secs,
+            secs > 0 ? (double)n / secs : 0.0);
+    fflush(csv);
+}
+
+static int reps_for(size_t n) { return n >= 1000000 ? 1 : BENCH_REPS; }
+
+// Ejecuta un comando del shell a partir de una línea (se trocea en una copia)
+static int run(const char *line) {
+    static char buf[PATH_MAX + 64];
+    snprintf(buf, sizeof buf, "%s", line);
+    if (tokenize(buf, &run_args) <= 0) return 1;
+    return processCommand(run_args.argc, run_args.argv);
+}
+
+/* ---------------------------- lista.c ---------------------------- */
+
+static int cmp_ptr(void *a, void *b) { return a == b ? 0 : 1; }
+
+static void bench_list(size_t n) {
+    double best_ins = 1e30, best_walk = 1e30, best_clear = 1e30;
+    double best_find = 1e30;
+    for (int r = 0; r < reps_for(n); ++r) {
+        List l;
+        initList(&l);
+        double t0 = now();
+        for (size_t i = 0; i < n; ++i)
+            insertItem(&l, (void *)(uintptr_t)(i + 1));
+        double t1 = now();
+        uintptr_t sum = 0;
+        for (tPos p = first(&l); p; p = p->next)
+            sum += (uintptr_t)getItem(&l, p);
+        double t2 = now();
+        // Búsqueda lineal del elemento más antiguo (peor caso)
+        if (findItem(&l, (void *)(uintptr_t)1, cmp_ptr) == NULL || sum == 0)
+            fprintf(stderr, "bench: list check failed\n");
+        double t3 = now();
+        clearList(&l, NULL);
+        double t4 = now();
+        if (t1 - t0 < best_ins) best_ins = t1 - t0;
+        if (t2 - t1 < best_walk) best_walk = t2 - t1;
+        if (t3 - t2 < best_find) best_find = t3 - t2;
+        if (t4 - t3 < best_clear) best_clear = t4 - t3;
+    }
+    report("lista", "insert", n, best_ins);
+    report("lista", "traverse", n, best_walk);
+    report("lista", "find_worst", n, best_find);
+    report("lista", "clear", n, best_clear);
+}
+
+/* ---------------------------- Despacho ---------------------------- */
+
+static void bench_dispatch(size_t n) {
+    static const char *const lines[] = {
+        "pid", "getpid", "date -d", "authors -l", "infosys"
+    };
+    const size_t nl = sizeof lines / sizeof lines[0];
+    double best = 1e30;
+    for (int r = 0; r < BENCH_REPS; ++r) {
+        double t0 = now();
+        for (size_t i = 0; i < n; ++i) run(lines[i % nl]);
+        double t = now() - t0;
+        if (t < best) best = t;
+    }
+    report("comandos", "dispatch_builtin", n, best);
+}
+
+/* ---------------------------- Historial ---------------------------- */
+
+static void bench_history(size_t n) {
+    char line[64];
+    double best_add = 1e30, best_get = 1e30;
+    for (int r = 0; r < reps_for(n); ++r) {
+        history_clear();
+        double t0 = now();
+        for (size_t i = 0; i < n; ++i) {
+            snprintf(line, sizeof line, "writestr 3 line-%zu", i);
+            history_add(line);
+        }
+        double t1 = now();
+        tItemH it;
+        size_t hits = 0;
+        int first_id = history_first_id();
+        size_t len = history_len();
+        for (size_t i = 0; i < n && len; ++i)
+            hits += history_get(first_id + (int)(i % len), &it);
+        double t2 = now();
+        if (hits == 0 && len) fprintf(stderr, "bench: history check failed\n");
+        if (t1 - t0 < best_add) best_add = t1 - t0;
+        if (t2 - t1 < best_get) best_get = t2 - t1;
+    }
+    report("historial", "add", n, best_add);
+    report("historial", "get", n, best_get);
+    history_clear();
+}
+
+/* ---------------------------- Ficheros ---------------------------- */
+
+static void bench_open_close(const char *dir, size_t n) {
+    char open_line[MAX_COMMAND], close_line[MAX_COMMAND];
+    snprintf(open_line, sizeof open_line, "open %s/churn cr", dir);
+    snprintf(close_line, sizeof close_line, "close %s/churn", dir);
+    double best = 1e30;
+    for (int r = 0; r < BENCH_REPS; ++r) {
+        double t0 = now();
+        for (size_t i = 0; i < n; ++i) {
+            run(open_line);
+            run(close_line);
+        }
+        double t = now() - t0;
+        if (t < best) best = t;
+    }
+    report("ficheros", "open_close", n, best);
+}
+
+// Árbol de prueba: fanout directorios por nivel y files ficheros en cada uno
+static size_t make_tree(const char *root, int depth, int fanout, int files) {
+    size_t entries = 0;
+    char path[PATH_MAX];
+    for (int f = 0; f < files; ++f) {
+        snprintf(path, sizeof path, "%s/file%03d", root, f);
+        int fd = open(path, O_CREAT | O_WRONLY | O_TRUNC, 0644);
+        if (fd >= 0) {
+            if (write(fd, path, (size_t)f) < 0) perror(path);
+            close(fd);
+            entries++;
+        }
+    }
+    if (depth == 0) return entries;
+    for (int d = 0; d < fanout; ++d) {
+        snprintf(path, sizeof path, "%s/dir%02d", root, d);
+        if (mkdir(path, 0755) != 0 && errno != EEXIST) continue;
+        entries += 1 + make_tree(path, depth - 1, fanout, files);
+    }
+    return entries;
+}
+
+static void bench_dir(const char *dir) {
+    char root[PATH_MAX], line[PATH_MAX + 64];
+    snprintf(root, sizeof root, "%s/tree", dir);
+    if (mkdir(root, 0755) != 0) { perror(root); return; }
+    size_t entries = make_tree(root, 3, 6, 20);
+
+    snprintf(line, sizeof line, "dir -d %s", root);
+    static const char *const modes[][2] = {
+        { "setdirparams short", "dir_d_short" },
+        { "setdirparams long", "dir_d_long" },
+        { "setdirparams long sort=name", "dir_d_long_name" },
+        { "setdirparams long sort=size", "dir_d_long_size" },
+    };
+    run("setdirparams reca");
+    for (size_t m = 0; m < sizeof modes / sizeof modes[0]; ++m) {
+        run(modes[m][0]);
+        double best = 1e30;
+        for (int r = 0; r < BENCH_REPS; ++r) {
+            double t0 = now();
+            run(line);
+            double t = now() - t0;
+            if (t < best) best = t;
+        }
+        report("ficheros", modes[m][1], entries, best);
+    }
+    run("setdirparams short sort=none");
+    run("setdirparams norec");
+
+    snprintf(line, sizeof line, "delrec %s", root);
+    double t0 = now();
+    run(line);
+    report("ficheros", "delrec", entries, now() - t0);
+}
+
+/* ---------------------------- Memoria ---------------------------- */
+
+static void bench_malloc_free(size_t n) {
+    double best = 1e30;
+    for (int r = 0; r < BENCH_REPS; ++r) {
+        double t0 = now();
+        for (size_t i = 0; i < n; ++i) {
+            run("malloc 4096");
+            run("malloc 4096 -free");
+        }
+        double t = now() - t0;
+        if (t < best) best = t;
+    }
+    report("memoria", "malloc_free", n, best);
+}
+
+/* ---------------------------- Procesos ---------------------------- */
+
+static void bench_spawn(size_t n) {
+    double best = 1e30;
+    for (int r = 0; r < BENCH_REPS; ++r) {
+        double t0 = now();
+        for (size_t i = 0; i < n; ++i) run("true");
+        double t = now() - t0;
+        if (t < best) best = t;
+    }
+    report("procesos", "spawn_external", n, best);
+}
+
+int main(void) {
+    // Resultados por una copia de stdout; los comandos escriben a /dev/null
+    int out = dup(STDOUT_FILENO);
+    int devnull = open("/dev/null", O_WRONLY);
+    if (out < 0 || devnull < 0 || !(csv = fdopen(out, "w"))) {
+        perror("bench");
+        return 1;
+    }
+    if (dup2(devnull, STDOUT_FILENO) < 0) { perror("dup2"); return 1; }
+    close(devnull);
+    setvbuf(stdout, NULL, _IOFBF, 64 * 1024);
+
+    // Sin registro persistente: el historial no debe tocar el del usuario
+    commands_init(false);
+    ficheros_init();
+    procesos_init();
+
+    char dir[] = "/tmp/p3-bench-XXXXXX";
+    if (!mkdtemp(dir)) { perror("mkdtemp"); return 1; }
+
+    fprintf(csv, "subsystem,op,n,seconds,ops_per_sec\n");
+    for (size_t n = 1000; n <= 10000000; n *= 10) bench_list(n);
+    bench_dispatch(100000);
+    bench_history(10000);
+    bench_history(1000000);
+    bench_open_close(dir, 10000);
+    bench_malloc_free(100000);
+    bench_dir(dir);
+    bench_spawn(200);
+
+    char line[PATH_MAX + 64];
+    snprintf(line, sizeof line, "delrec %s", dir);
+    run(line);
+    args_free(&run_args);
+    commands_shutdown();
+    ficheros_shutdown();
+    procesos_destroy();
+    mem_cleanup();
+    fclose(csv);
+    return 0;
+}
@@ -0,0 +1,317 @@
+// Pablo Araújo Rodríguez   pablo.araujo@udc.es
+// Uriel Liñares Vaamonde   uriel.linaresv@udc.es
+
+#define _GNU_SOURCE
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#ifdef __linux__
+#include <sys/inotify.h>
+#endif
+#include "cachedir.h"
+#include "contenedores.h"
+
+// Pasado este número de entradas guardadas se vacía la caché entera
+#define DCACHE_MAX_ENTRIES (1u << 20)
+
+#define WATCH_MASK (IN_CREATE | IN_DELETE | IN_MOVED_FROM | IN_MOVED_TO | \
+                    IN_MODIFY | IN_ATTRIB | IN_DELETE_SELF | IN_MOVE_SELF | \
+                    IN_ONLYDIR)
+#define ENTRY_CHANGES (IN_CREATE | IN_DELETE | IN_MOVED_FROM | IN_MOVED_TO)
+
+typedef struct {
+    dev_t dev;
+    ino_t ino;
+} tDcKey;
+
+typedef struct {
+    tDcKey key;
+    tDcKey parent;                  // para invalidarlo cuando cambie este
+    bool has_parent;
+    int wd;                         // -1: sin inotify, se mira el mtime
+    unsigned long long events;      // cambios vistos desde que se creó
+    struct timespec mtime, ctime;   // del directorio al leerlo
+    tDirSnap *snap;                 // NULL si no hay copia válida
+} tDcEntry;
+
+static pthread_mutex_t dc_lock = PTHREAD_MUTEX_INITIALIZER;
+static bool dc_ready = false;
+static int dc_ifd = -1;             // descriptor de inotify
+static tHashMap dc_by_key;          // tDcKey* -> tDcEntry*
+static tHashMap dc_by_wd;           // wd -> tDcEntry*
+static size_t dc_entries = 0;       // entradas en copias válidas
+
+static uint64_t hash_key(const void *k) {
+    const tDcKey *d = k;
+    // Mezcla de splitmix64 sobre los dos campos
+    uint64_t x = (uint64_t)d->ino * 0x9e3779b97f4a7c15ull ^ (uint64_t)d->dev;
+    x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ull;
+    x = (x ^ (x >> 27)) * 0x94d049bb133111ebull;
+    return x ^ (x >> 31);
+}
+
+static bool eq_key(const void *a, const void *b) {
+    const tDcKey *x = a, *y = b;
+    return x->dev == y->dev && x->ino == y->ino;
+}
+
+static void ensure_init(void) {
+    if (dc_ready) return;
+    hashmap_init(&dc_by_key, hash_key, eq_key);
+    hashmap_init(&dc_by_wd, hash_ptr, eq_ptr);
+#ifdef __linux__
+    dc_ifd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+#endif
+    dc_ready = true;
+}
+
+void dcache_release(const tDirSnap *s) {
+    if (!s) return;
+    tDirSnap *m = (tDirSnap *)s;
+    if (atomic_fetch_sub(&m->refs, 1) == 1) free(m);
+}
+
+static void entry_drop_snap(tDcEntry *e) {
+    if (!e->snap) return;
+    dc_entries -= e->snap->count;
+    dcache_release(e->snap);
+    e->snap = NULL;
+}
+
+static void entry_free(tDcEntry *e, bool rm_watch) {
+    entry_drop_snap(e);
+    if (e->wd >= 0) {
+        hashmap_remove(&dc_by_wd, (const void *)(intptr_t)e->wd);
+#ifdef __linux__
+        if (rm_watch) inotify_rm_watch(dc_ifd, e->wd);
+#endif
+    }
+    (void)rm_watch;
+    hashmap_remove(&dc_by_key, &e->key);
+    free(e);
+}
+
+// Una sola pasada liberando entradas; las tablas se vacían al final
+static void clear_locked(void) {
+    size_t it = 0;
+    for (tHashSlot *s; (s = hashmap_next(&dc_by_key, &it));) {
+        tDcEntry *e = s->value;
+        entry_drop_snap(e);
+#ifdef __linux__
+        if (e->wd >= 0) inotify_rm_watch(dc_ifd, e->wd);
+#endif
+        free(e);
+    }
+    hashmap_clear(&dc_by_key);
+    hashmap_clear(&dc_by_wd);
+}
+
+/* Aplica los eventos pendientes de inotify: cualquier cambio invalida la
+ * copia del directorio vigilado; si la cola se desbordó, todas */
+static void drain_events(void) {
+#ifdef __linux__
+    if (dc_ifd < 0) return;
+    char buf[8192] __attribute__((aligned(__alignof__(struct inotify_event))));
+    for (;;) {
+        ssize_t n = read(dc_ifd, buf, sizeof buf);
+        if (n <= 0) break;      // EAGAIN: no hay más
+        for (char *p = buf; p < buf + n;) {
+            const struct inotify_event *ev = (const struct inotify_event *)p;
+            p += sizeof *ev + ev->len;
+            if (ev->mask & IN_Q_OVERFLOW) {
+                size_t it = 0;
+                for (tHashSlot *s; (s = hashmap_next(&dc_by_key, &it));) {
+                    tDcEntry *e = s->value;
+                    e->events++;
+                    entry_drop_snap(e);
+                }
+                continue;
+            }
+            tDcEntry *e = hashmap_get(&dc_by_wd,
+                                      (const void *)(intptr_t)ev->wd);
+            if (!e) continue;
+            e->events++;
+            entry_drop_snap(e);
+            /* Las altas y bajas cambian el mtime, el tamaño y los enlaces
+             * de este directorio, que el padre muestra sin recibir evento */
+            if ((ev->mask & ENTRY_CHANGES) && e->has_parent) {
+                tDcEntry *pe = hashmap_get(&dc_by_key, &e->parent);
+                if (pe) { pe->events++; entry_drop_snap(pe); }
+            }
+            // El kernel ya quitó la vigilancia (directorio borrado...)
+            if (ev->mask & IN_IGNORED) entry_free(e, false);
+        }
+    }
+#endif
+}
+
+static int add_watch(int dfd) {
+#ifdef __linux__
+    if (dc_ifd < 0) return -1;
+    // inotify pide una ruta: la del descriptor ya abierto
+    char path[64];
+    snprintf(path, sizeof path, "/proc/self/fd/%d", dfd);
+    return inotify_add_watch(dc_ifd, path, WATCH_MASK);
+#else
+    (void)dfd;
+    return -1;
+#endif
+}
+
+static bool same_time(const struct timespec *a, const struct timespec *b) {
+    return a->tv_sec == b->tv_sec && a->tv_nsec == b->tv_nsec;
+}
+
+const tDirSnap *dcache_get(int dfd, tDcTicket *t) {
+    t->ok = false;
+    struct stat sb;
+    if (fstat(dfd, &sb) != 0) return NULL;
+    tDcKey key = { sb.st_dev, sb.st_ino };
+    pthread_mutex_lock(&dc_lock);
+    ensure_init();
+    drain_events();
+    tDcEntry *e = hashmap_get(&dc_by_key, &key);
+    if (e && e->snap) {
+        if (e->wd >= 0 || (same_time(&e->mtime, &sb.st_mtim) &&
+                           same_time(&e->ctime, &sb.st_ctim))) {
+            tDirSnap *s = e->snap;
+            atomic_fetch_add(&s->refs, 1);
+            pthread_mutex_unlock(&dc_lock);
+            return s;
+        }
+        entry_drop_snap(e);
+    }
+    pthread_mutex_unlock(&dc_lock);
+
+    // Hay que leerlo: se anota el padre actual (puede haberse movido)
+    struct stat psb;
+    bool has_parent = fstatat(dfd, "..", &psb, 0) == 0 &&
+                      (psb.st_dev != sb.st_dev || psb.st_ino != sb.st_ino);
+    pthread_mutex_lock(&dc_lock);
+    e = hashmap_get(&dc_by_key, &key);
+    if (!e) {
+        e = calloc(1, sizeof *e);
+        if (!e) { pthread_mutex_unlock(&dc_lock); return NULL; }
+        e->key = key;
+        // La vigilancia va antes de leer: nada de lo que cambie se pierde
+        e->wd = add_watch(dfd);
+        if (hashmap_put(&dc_by_key, &e->key, e) != 0) {
+            e->wd = -1;     // la vigilancia se queda sin dueño, inofensiva
+            free(e);
+            pthread_mutex_unlock(&dc_lock);
+            return NULL;
+        }
+        if (e->wd >= 0) {
+            // wd reutilizado de una vigilancia retirada aún sin procesar
+            tDcEntry *old = hashmap_get(&dc_by_wd, (const void *)(intptr_t)e->wd);
+            if (old && old != e) entry_free(old, false);
+            if (hashmap_put(&dc_by_wd, (const void *)(intptr_t)e->wd, e) != 0)
+                e->wd = -1;
+        }
+    }
+    e->has_parent = has_parent;
+    if (has_parent) e->parent = (tDcKey){ psb.st_dev, psb.st_ino };
+    t->dev = key.dev;
+    t->ino = key.ino;
+    t->events = e->events;
+    t->mtime = sb.st_mtim;
+    t->ctime = sb.st_ctim;
+    t->ok = true;
+    pthread_mutex_unlock(&dc_lock);
+    return NULL;
+}
+
+// Copia en un solo bloque: cabecera, metadatos, desplazamientos, errores y nombres
+static tDirSnap *snap_new(const char *names, size_t names_len,
+                          const size_t *offs, size_t count,
+                          const tMeta *meta, const int *errs) {
+    size_t sz_meta = count * sizeof *meta, sz_offs = count * sizeof *offs;
+    size_t sz_errs = count * sizeof *errs;
+    tDirSnap *s = malloc(sizeof *s + sz_meta + sz_offs + sz_errs + names_len);
+    if (!s) return NULL;
+    char *p = (char *)(s + 1);
+    s->meta = (const tMeta *)p;
+    s->offs = (const size_t *)(p + sz_meta);
+    s->errs = (const int *)(p + sz_meta + sz_offs);
+    // Un directorio vacío llega con punteros nulos
+    if (count) {
+        memcpy(p, meta, sz_meta);
+        memcpy(p + sz_meta, offs, sz_offs);
+        memcpy(p + sz_meta + sz_offs, errs, sz_errs);
+    }
+    p += sz_meta + sz_offs + sz_errs;
+    if (names_len) memcpy(p, names, names_len);
+    s->names = p;
+    s->count = count;
+    atomic_init(&s->refs, 1);
+    return s;
+}
+
+void dcache_put(const tDcTicket *t, const char *names, size_t names_len,
+                const size_t *offs, size_t count, const tMeta *meta,
+                const int *errs) {
+    if (!t->ok || count > DCACHE_MAX_ENTRIES) return;
+    tDirSnap *s = snap_new(names, names_len, offs, count, meta, errs);
+    if (!s) return;
+    tDcKey key = { t->dev, t->ino };
+    pthread_mutex_lock(&dc_lock);
+    drain_events();
+    tDcEntry *e = hashmap_get(&dc_by_key, &key);
+    // Si algo cambió mientras se leía, lo leído no sirve
+    if (!e || e->events != t->events) {
+        pthread_mutex_unlock(&dc_lock);
+        free(s);
+        return;
+    }
+    if (dc_entries + count > DCACHE_MAX_ENTRIES) {
+        clear_locked();
+        pthread_mutex_unlock(&dc_lock);
+        free(s);
+        return;
+    }
+    entry_drop_snap(e);
+    e->snap = s;
+    e->mtime = t->mtime;
+    e->ctime = t->ctime;
+    dc_entries += count;
+    pthread_mutex_unlock(&dc_lock);
+}
+
+void dcache_info(size_t *dirs, size_t *entries, bool *watched) {
+    pthread_mutex_lock(&dc_lock);
+    size_t n = 0;
+    if (dc_ready) {
+        drain_events();
+        size_t it = 0;
+        for (tHashSlot *s; (s = hashmap_next(&dc_by_key, &it));)
+            if (((tDcEntry *)s->value)->snap) ++n;
+    }
+    *dirs = n;
+    *entries = dc_entries;
+    *watched = dc_ifd >= 0;
+    pthread_mutex_unlock(&dc_lock);
+}
+
+void dcache_clear(void) {
+    pthread_mutex_lock(&dc_lock);
+    if (dc_ready) clear_locked();
+    pthread_mutex_unlock(&dc_lock);
+}
+
+void dcache_shutdown(void) {
+    pthread_mutex_lock(&dc_lock);
+    if (dc_ready) {
+        clear_locked();
+        hashmap_free(&dc_by_key);
+        hashmap_free(&dc_by_wd);
+        if (dc_ifd >= 0) close(dc_ifd);
+        dc_ifd = -1;
+        dc_ready = false;
+    }
+    pthread_mutex_unlock(&dc_lock);
+}
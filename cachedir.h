@@ -0,0 +1,56 @@
+// Pablo Araújo Rodríguez   pablo.araujo@udc.es
+// Uriel Liñares Vaamonde   uriel.linaresv@udc.es
+
+#ifndef CACHEDIR_H
+#define CACHEDIR_H
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <sys/types.h>
+#include <time.h>
+#include "metadatos.h"
+
+/* Caché de listados de directorio por (dispositivo, inodo): guarda los
+ * nombres de todas las entradas (ocultas incluidas) y sus metadatos. Cada
+ * directorio guardado se vigila con inotify y cualquier cambio en él o en
+ * sus entradas lo invalida. Si no se puede vigilar (sin inotify o sin
+ * vigilancias libres), la copia vale mientras no cambien el mtime ni el
+ * ctime del directorio, lo que solo detecta altas, bajas y renombrados.
+ * Los metadatos de los subdirectorios guardados no se usan tal cual: cambian
+ * sin aviso para el padre y quien lista los vuelve a pedir. */
+
+// Copia inmutable de un directorio; se suelta con dcache_release
+typedef struct {
+    atomic_int refs;
+    size_t count;
+    const char *names;      // nombres seguidos, cada uno con su '\0'
+    const size_t *offs;     // desplazamiento de cada nombre en names
+    const tMeta *meta;
+    const int *errs;        // errno de cada entrada (0 si hay metadatos)
+} tDirSnap;
+
+// Estado del directorio antes de leerlo, para dcache_put
+typedef struct {
+    dev_t dev;
+    ino_t ino;
+    unsigned long long events;
+    struct timespec mtime, ctime;
+    bool ok;
+} tDcTicket;
+
+// Copia válida del directorio abierto en dfd o NULL (y t listo para leer)
+const tDirSnap *dcache_get(int dfd, tDcTicket *t);
+void dcache_release(const tDirSnap *s);
+// Guarda lo leído si el directorio no ha cambiado desde dcache_get
+void dcache_put(const tDcTicket *t, const char *names, size_t names_len,
+                const size_t *offs, size_t count, const tMeta *meta,
+                const int *errs);
+
+// Directorios y entradas guardados; watched indica si hay inotify
+void dcache_info(size_t *dirs, size_t *entries, bool *watched);
+// Vacía la caché y quita las vigilancias
+void dcache_clear(void);
+void dcache_shutdown(void);
+
+#endif //CACHEDIR_H
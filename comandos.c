@@ -3,124 +3,178 @@
 
 #define _POSIX_C_SOURCE 200809L
 #include <errno.h>
+#include <limits.h>
 #include "comandos.h"
+#include "phash.h"
+#include "comandos_phash.h"
 
-static List *history = NULL;
-static int history_command_count = 0;
+static void listarHistorialDeComandos(void);
+static void release_extra_commands(void);
 
-static void listarHistorialDeComandos(const List *list);
-
-static void ensure_history_storage(void) {
-    if (!history) history = createList();
-}
-
-void commands_init(void) {
-    ensure_history_storage();
-    clearList(history, delHist);
-    history_command_count = 0;
+void commands_init(bool persist_history) {
+    if (history_init(HISTORY_MAX) != 0) perror("history_init");
+    const char *log = persist_history ? history_log_default_path() : NULL;
+    if (log && history_log_open(log) != 0)
+        fprintf(stderr, "History log %s unavailable: %s\n", log,
+                strerror(errno));
 }
 
 void commands_shutdown(void) {
-    if (!history) return;
-    deleteList(history, delHist);
-    history = NULL;
-    history_command_count = 0;
+    history_log_close();
+    history_shutdown();
+    release_extra_commands();
+    stats_shutdown();
 }
 
-// Tabla de comandos
-static command_entry commands[] = {
-    {"authors", cmd_authors, "Prints the names and logins of the program authors.\n"
-        "\tauthors -l\tPrints only the logins.\n\tauthors -n\tPrints only the "
-        "names"},
-    {"bye", cmd_exit, "Ends the shell"},
-    {"cd", cmd_cd, "Changes the current working directory of the shell to dir. When invoked without arguments it prints the current working directory."},
-    {"chdir", cmd_cd, "Changes the current working directory of the shell to dir. "
-        "When invoked without auguments it prints the current working directory"
-        "."},
-    {"close", cmd_close, "Closes the df file descriptor and eliminates the "
-        "corresponding item from the list"},
-    {"cls", cmd_clear, "Clears the shell screen."},
-    {"create", cmd_create, "\n\tcreate -f 'name':\tCreates a file\n\tcreate 'name':"
-        "\t\tCreates a directory"},
-    {"cwd", cmd_cwd, "Prints the current working directory of the shell or changes it when used via 'cwd dir'"},
-    {"date", cmd_date, "Prints the current date in the format DD/MM/YYYY and the "
-        "current time in the format hh:mm:ss.\n\t\tdate -d\tPrints the current "
-        "date in the format DD/MM/YYYY\n\t\tdate -t\tPrints and the current "
-        "time in the format hh:mm:ss."},
-    {"deljobs", cmd_deljobs, "deljobs -term|-sig: removes finished or signaled background jobs from the list"},
-    {"delrec", cmd_delrec, "Deletes a file or directory recursively"},
-    {"dir", cmd_dir, "dir [-long|-short] [-link|-nolink] [-d] [hid|nohid] "
-        "[reca|recb|norec] [n1 n2 ...] Shows info for files/dirs;\n\t-d\t\t"
-        "lists directory contents;\n\thid/nohid\tincludes hidden; \n\t"
-        "reca/recb/norec\tcontrols recursion."},
-    {"dup", cmd_dup, "Duplicates the df file descriptor"},
-    {"envvar", cmd_envvar, "envvar -show VAR | envvar -change [-a|-e|-p] VAR VALUE: "
-        "displays or updates environment variables"},
-    {"erase", cmd_erase, "erase 'name':\tErases the empty files or directories "
-        "specified by 'name'"},
-    {"exec", cmd_exec, "exec progspec: executes the program in foreground (no background) and returns to the shell"},
-    {"exit", cmd_exit, "Ends the shell"},
-    {"fork", cmd_fork, "fork: creates a child process and waits for it to finish"},
-    {"free", cmd_free, "free addr: releases the block associated with addr"},
-    {"getcwd", cmd_cwd, "Prints the current working directory of the shell"},
-    {"getdirparams", cmd_getdirparams, "Shows the value of the parameters for "
-        "listing with dir"},
-    {"getpid", cmd_getpid,"Prints the pid of the process executing the shell."},
-    {"help", cmd_help, "help displays a list of available commands. help cmd gives "
-        "a brief help on the usage of command cmd"},
-    {"historic", cmd_historic, "Shows the history of commands executed by this "
-        "shell.\n\t– historic\t\tPrints all the commands that have been input "
-        "with their order number\n\t– historic N\t\tRepeats command number N"
-        "\n\t– historic -N\t\tPrints only the last N commands\n  historic "
-        "[-clear|-count]\tClears the history list or reports its number of "
-        "elements\n\t– historic -count\tReports how many commands there are in "
-        "the history list\n\t– historic -clear\tClears the history list"},
-    {"hour", cmd_date, "Prints and the current time in the format hh:mm:ss." },
-    {"infosys", cmd_infosys, "Prints information on the machine running the shell"},
-    {"jobs", cmd_jobs, "jobs: lists tracked background processes"},
-    {"listopen", cmd_listOpen,"Lists the shell open files"},
-    {"lseek", cmd_lseek, "lseek df offset whence: Repositions the offset of the"
-        " file descriptor df to the argument offset according to the directive "
-        "whence (SEEK_SET, SEEK_CUR or SEEK_END)"},
-    {"malloc", cmd_malloc, "malloc n: allocates n bytes; without arguments it lists tracked malloc blocks"},
-    {"mem", cmd_mem, "mem -funcs | -vars | -blocks | -all | -pmap: prints memory information (addresses, tracked blocks, and process map)"},
-    {"memdump", cmd_memdump, "memdump addr count: dumps count bytes starting at addr in hexadecimal and printable form"},
-    {"memfill", cmd_memfill, "memfill addr count byte: fills count bytes at addr with the byte value"},
-    {"mmap", cmd_mmap, "mmap file perms: maps the file; mmap -free file: unmaps an active mapping"},
-    {"open", cmd_open, "Opens a file and adds it. Open without arguments lists "
-        "the shell open files. For each file it lists its descriptor, the file "
-        "name and the opening mode."},
-    {"pid", cmd_getpid,"Prints the pid of the process executing the shell."},
-    {"pwd", cmd_cwd, "Prints the current working directory of the shell"},
-    {"quit", cmd_exit, "Ends the shell"},
-    {"read", cmd_read, "read fd addr count: reads count bytes from descriptor fd into addr"},
-    {"readfile", cmd_readfile, "readfile file addr [count]: reads bytes from file into addr"},
-    {"recurse", cmd_recurse, "Executes the recursive function n times. The function allocates an automatic array of size 1024, a static array of size 1024, and prints the addresses of both arrays plus the parameter on each recursion level"},
-    {"setdirparams", cmd_setdirparams, "setdirparams long|short | link|nolink | "
-        "hid|nohid | reca|recb|norec: sets listing parameters for 'dir' "
-        "(format, symlink target, hidden files, and recursion order/disable)."},
-    {"shared", cmd_shared, "shared key: attaches; shared -create key size: creates and attaches; shared -free key: detaches; shared -delkey key: removes"},
-    {"showenv", cmd_showenv, "showenv [-environ|-addr]: lists the stored environment or the environ pointer addresses"},
-    {"uid", cmd_uid, "uid -get | uid -set [-l] id: shows credentials or changes the shell's real/effective IDs"},
-    {"write", cmd_write, "write fd addr count: writes count bytes from addr to descriptor fd"},
-    {"writefile", cmd_writefile, "writefile [-o] file addr count: writes bytes from memory into file"},
-    {"writestr", cmd_writestr, "writestr fd str: writes the string str to the "
-        "descriptor df"},
+// Tabla de comandos (ver comandos.def)
+static const command_entry commands[] = {
+#define CMD(name, fn, help) { name, fn, help },
+#include "comandos.def"
+#undef CMD
 };
 
 static const size_t n_commands = sizeof(commands) / sizeof(commands[0]);
 
-static int command_cmp(const void *keyp, const void *elem) {
-    const char *key = *(const char * const *)keyp;
-    const command_entry *entry = (const command_entry *)elem;
-    return strcmp(key, entry->name);
+_Static_assert(CMD_PHASH_COUNT == sizeof(commands) / sizeof(commands[0]),
+               "comandos_phash.h is out of date with comandos.def");
+
+// Comandos añadidos en tiempo de ejecución (nombre -> command_entry*)
+static tHashMap extra_commands;
+static bool extra_ready = false;
+
+// Un único sondeo en la tabla generada y, si no está, el mapa dinámico
+static const command_entry *find_command(const char *name) {
+    size_t h = cmd_phash(name, CMD_PHASH_SEED) & (CMD_PHASH_SIZE - 1);
+    short i = cmd_phash_slots[h];
+    if (i >= 0 && strcmp(commands[i].name, name) == 0) return &commands[i];
+    if (!extra_ready) return NULL;
+    return hashmap_get(&extra_commands, name);
+}
+
+int commands_register(const char *name, command_fn func, const char *help) {
+    if (!name || !func) { errno = EINVAL; return -1; }
+    if (find_command(name)) { errno = EEXIST; return -1; }
+    command_entry *e = malloc(sizeof *e);
+    if (!e) return -1;
+    e->name = name;
+    e->func = func;
+    e->help = help ? help : "";
+    if (!extra_ready) {
+        hashmap_init(&extra_commands, hash_str, eq_str);
+        extra_ready = true;
+    }
+    if (hashmap_put(&extra_commands, e->name, e) != 0) {
+        free(e);
+        return -1;
+    }
+    return 0;
+}
+
+static void release_extra_commands(void) {
+    if (!extra_ready) return;
+    size_t it = 0;
+    for (tHashSlot *s; (s = hashmap_next(&extra_commands, &it));) free(s->value);
+    hashmap_free(&extra_commands);
+    extra_ready = false;
+}
+
+void args_init(tArgs *a) {
+    a->argv = NULL;
+    a->spans = NULL;
+    a->argc = 0;
+    a->cap = 0;
+}
+
+void args_free(tArgs *a) {
+    free(a->argv);
+    free(a->spans);
+    args_init(a);
 }
 
-char *readCommand(char *command, bool read)
+static int args_push(tArgs *a, char *base, size_t off, size_t len) {
+    // Siempre queda un hueco para el NULL final de argv
+    if (a->argc + 2 > a->cap) {
+        int ncap = a->cap ? a->cap * 2 : 16;
+        char **nargv = realloc(a->argv, (size_t)ncap * sizeof *nargv);
+        if (!nargv) return -1;
+        a->argv = nargv;
+        tSpan *nspans = realloc(a->spans, (size_t)ncap * sizeof *nspans);
+        if (!nspans) return -1;
+        a->spans = nspans;
+        a->cap = ncap;
+    }
+    a->spans[a->argc].off = off;
+    a->spans[a->argc].len = len;
+    a->argv[a->argc++] = base + off;
+    a->argv[a->argc] = NULL;
+    return 0;
+}
+
+static bool is_separator(char c) { return c == ' ' || c == '\t' || c == '\n'; }
+
+int tokenize(char *line, tArgs *out)
 {
-    size_t len = 0;
+    out->argc = 0;
+    if (args_push(out, line, 0, 0) != 0) return -1;  // asegura argv[0]
+    out->argc = 0;
+    out->argv[0] = NULL;
+    char *r = line, *w = line;
+    for (;;) {
+        while (is_separator(*r)) r++;
+        if (*r == '\0') break;
+        char *start = w;
+        char quote = 0;
+        // Copia el token sobre sí mismo quitando comillas y escapes
+        for (; *r; ++r) {
+            char c = *r;
+            if (quote) {
+                if (c == quote) { quote = 0; continue; }
+                if (quote == '"' && c == '\\' && (r[1] == '"' || r[1] == '\\'))
+                    c = *++r;
+                *w++ = c;
+            } else if (c == '\'' || c == '"') quote = c;
+            else if (c == '\\' && r[1] != '\0') *w++ = *++r;
+            else if (is_separator(c)) break;
+            else *w++ = c;
+        }
+        if (quote) {
+            fprintf(stderr, "Unterminated quote in command line\n");
+            out->argc = 0;
+            out->argv[0] = NULL;
+            return -1;
+        }
+        bool end = (*r == '\0');
+        if (!end) r++;
+        *w++ = '\0';
+        if (args_push(out, line, (size_t)(start - line),
+                      (size_t)(w - 1 - start)) != 0) {
+            perror("tokenize");
+            return -1;
+        }
+        if (end) break;
+    }
+    return out->argc;
+}
+
+int args_from_blob(char *blob, int argc, tArgs *out)
+{
+    out->argc = 0;
+    if (args_push(out, blob, 0, 0) != 0) return -1;
+    out->argc = 0;
+    out->argv[0] = NULL;
+    size_t off = 0;
+    for (int i = 0; i < argc; ++i) {
+        size_t len = strlen(blob + off);
+        if (args_push(out, blob, off, len) != 0) return -1;
+        off += len + 1;
+    }
+    return out->argc;
+}
 
-    ensure_history_storage();
+char *readCommand(char *command, bool read, tArgs *args)
+{
+    size_t len = 0;
+    args->argc = 0;
 
     // Leemos el comando
     if (read) {
@@ -137,59 +191,45 @@ char *readCommand(char *command, bool read)
         if (command[0] == '\0') return command;
     }
 
-    // Reserva en heap el item del historial
-    tItemH *item = malloc(sizeof *item);
-    if (!item) { perror("malloc"); return NULL; }
-
-    // Incrementa el contador de comandos
-    item->id   = history_command_count++;
-    item->name = strdup(command);
-    if (!item->name) { perror("strdup"); free(item); return NULL; }
-
-    // Insertamos el comando en el historial
-    if (insertItem(history, item) != 0) {
-        free(item->name);
-        free(item);
+    // Insertamos el comando en el historial (se copia a su arena)
+    int id = history_add(command);
+    if (id < 0)
         perror("Error inserting command into history");
-        return NULL;
-    }
+    // Troceamos in situ y guardamos el resultado junto a la entrada
+    if (tokenize(command, args) > 0 && id >= 0)
+        history_set_args(id, args->argv, args->argc);
     return command;
 }
 
-int chopString(char * argc, char * argv[])
-{
-    int i=1;
-    if ((argv[0]=strtok(argc," \n\t"))==NULL)
-        return 0;
-    while ((argv[i]=strtok(NULL," \n\t"))!=NULL)
-        i++;
-    return i;
-}
-
 int processCommand(int argc, char *argv[])
 {
     procesos_refresh();
     if (argc < 1) return 0;
-    command_entry *e = bsearch(&argv[0], commands, n_commands,
-                                sizeof(commands[0]), command_cmp);
-    if (e != NULL) {
-        return e->func(argc, argv); // Ejecuta el handler
-    }
-    return execute_external_command(argc, argv);
+    // argv puede cambiar durante el comando: guardamos el nombre antes
+    char name[64];
+    snprintf(name, sizeof name, "%s", argv[0]);
+    tStatsMark mark;
+    stats_begin(&mark);
+    int rc;
+    const command_entry *e = find_command(argv[0]);
+    if (e != NULL) rc = e->func(argc, argv); // Ejecuta el handler
+    else rc = execute_external_command(argc, argv);
+    stats_end(name, &mark);
+    return rc;
 }
 
 int cmd_historic(int argc, char *argv[]) {
-    ensure_history_storage();
-    if (!history || history->head == NULL) {
+    // Un historial vacío no es un error (el modo script cuenta los fallos)
+    if (history_len() == 0) {
         printf("Empty List\n");
-        return 1;
+        return 0;
     }
 
     // Si no se especifica parámetro, listamos el historial completo
     if (argc == 1)
     {
-        listarHistorialDeComandos(history);
-        return 1;
+        listarHistorialDeComandos();
+        return 0;
     }
     if (strcmp(argv[1], "-clear")==0)
     {
@@ -198,7 +238,22 @@ int cmd_historic(int argc, char *argv[]) {
     }
     if (strcmp(argv[1], "-count")==0)
     {
-        printf("%d", history_command_count);
+        printf("%d", history_next_id());
+        return 0;
+    }
+    if (strcmp(argv[1], "-max")==0)
+    {
+        if (argc == 2) { printf("%zu\n", history_max()); return 0; }
+        char *end;
+        long n = strtol(argv[2], &end, 10);
+        if (*end != '\0' || n <= 0) {
+            fprintf(stderr, "Invalid size for historic -max\n");
+            return 1;
+        }
+        if (history_set_max((size_t)n) != 0) {
+            perror("historic -max");
+            return 1;
+        }
         return 0;
     }
 
@@ -214,68 +269,59 @@ int cmd_historic(int argc, char *argv[]) {
 
     // Si se proporciona un número negativo, mostramos los últimos n comandos
     if (i < 0) {
-        int count = 0;
-        for (Node *x = history->head; x != NULL && count < -i; x = x->next) {
-            tItemH *y = (tItemH*)x->data;
-            printf("%d\t%s\n", y->id, y->name);
-            count++;
-        }
+        tItemH y;
+        int last = history_next_id() - 1;
+        for (long k = 0; k < -i && history_get(last - (int)k, &y); ++k)
+            printf("%d\t%s\n", y.id, y.name);
         return 0;
     }
 
-    // Si el número es positivo, buscamos el comando por su ID y lo ejecutamos
-    int count = 0;
-    Node *x = history->head;
-    while (x != NULL && count < history_command_count-i-1) {  // avanzar i pasos
-        x = x->next;
-        count++;
-    }
-    if (x == NULL || i > history_command_count) {
+    // Si el número es positivo, accedemos directamente por su ID
+    tItemH entry;
+    tItemH *y = &entry;
+    if (i > INT_MAX || !history_get((int)i, y)) {
         printf("Position %ld does not exist in historic\n", i);
         return 1;
     }
-    tItemH *y = (tItemH*)x->data;
 
-    // Evitamos el bucle infinito
-    if (strcmp(y->name, "historic") == 0) {
+    // Evitamos el bucle infinito: repetir otro historic puede volver aquí
+    size_t w = strspn(y->name, " \t");
+    if (strncmp(y->name + w, "historic", 8) == 0 &&
+        (y->name[w + 8] == '\0' || strchr(" \t", y->name[w + 8]))) {
         printf("Error: infinite loop\n");
         return 1;
     }
     printf("%d -> %s\n", y->id, y->name);
-    char *argv2[MAX_TR] = {0};
-    const int argc2 = chopString(y->name, argv2);
-    processCommand(argc2, argv2);
-    return 0;
-}
-
-static void listarHistorialDeComandos(const List *list) {
-    if (!list) {
-        puts("Empty list or null pointer.");
-        return;
-    }
-    const Node *current = list->head;
-    while (current) {
-        const tItemH *it = (const tItemH*)current->data;
-        if (it) {
-            printf("id: %d, name: %s\n", it->id, it->name);
-        }
-        current = current->next;
+    // Copia propia: el comando repetido puede modificar el historial
+    size_t n = strlen(y->name) + 1;
+    char *line = malloc(n);
+    if (!line) { perror("malloc"); return 1; }
+    tArgs args;
+    args_init(&args);
+    int argc2;
+    if (y->args) {
+        memcpy(line, y->args, n);
+        argc2 = args_from_blob(line, y->argc, &args);
+    } else {
+        memcpy(line, y->name, n);
+        argc2 = tokenize(line, &args);
     }
+    if (argc2 > 0) processCommand(argc2, args.argv);
+    args_free(&args);
+    free(line);
+    return 0;
 }
 
-void delHist(void *item)
-{
-    if (!item) return;
-    tItemH *h = (tItemH*)item;
-    free(h->name);   // <- liberar el strdup
-    free(h);
+static void listarHistorialDeComandos(void) {
+    // Del más reciente al más antiguo
+    tItemH it;
+    for (int id = history_next_id() - 1; history_get(id, &it); --id)
+        printf("id: %d, name: %s\n", it.id, it.name);
 }
 
 void historic_clear(void)
 {
-    if (!history) return;
-    clearList(history, delHist);
-    history_command_count = 0;
+    history_clear();
 }
 
 static void print_help_entry(const command_entry *e) {
@@ -289,11 +335,21 @@ static void print_all_help(void) {
         size_t w = strlen(commands[i].name);
         if (w > maxw) maxw = w;
     }
+    size_t it = 0;
+    for (tHashSlot *s; extra_ready && (s = hashmap_next(&extra_commands, &it));) {
+        size_t w = strlen(((const command_entry *)s->value)->name);
+        if (w > maxw) maxw = w;
+    }
     // Listado
     puts("Available commands:\n");
     for (size_t i = 0; i < n_commands; ++i) {
         printf("  %-*s  %s\n", (int)maxw, commands[i].name, commands[i].help);
     }
+    it = 0;
+    for (tHashSlot *s; extra_ready && (s = hashmap_next(&extra_commands, &it));) {
+        const command_entry *e = s->value;
+        printf("  %-*s  %s\n", (int)maxw, e->name, e->help);
+    }
 }
 
 int cmd_help(int argc, char *argv[])
@@ -307,13 +363,7 @@ int cmd_help(int argc, char *argv[])
     // Buscamos el comando en la tabla e imprimimos su help
     int status = 0;
     for (int i = 1; i < argc; ++i) {
-        const command_entry *found = NULL;
-        for (size_t j = 0; j < n_commands; ++j) {
-            if (strcmp(argv[i], commands[j].name) == 0) {
-                found = &commands[j];
-                break;
-            }
-        }
+        const command_entry *found = find_command(argv[i]);
         if (found) {
             print_help_entry(found);
         } else {
@@ -7,10 +7,13 @@
 #include <stdbool.h>
 #include <string.h>
 #include "lista.h"
+#include "contenedores.h"
+#include "historial.h"
 #include "p3.h"
 #include "memoria.h"
 #include "ficheros.h"
 #include "procesos.h"
+#include "estadisticas.h"
 
 typedef int (*command_fn)(int argc, char *argv[]);
 
@@ -20,32 +23,51 @@ typedef struct {
     const char *help;
 } command_entry;
 
-typedef struct tItemH{
-    int id;
-    char *name;
-}tItemH;
-
-void commands_init(void);
+/* Con persist_history el historial se añade también al registro
+ * persistente compartido (sesiones interactivas; los scripts no lo tocan) */
+void commands_init(bool persist_history);
 void commands_shutdown(void);
 
-// Lee un comando y lo añade al historial
-char *readCommand(char *command, bool read);
+// Argumentos troceados: argv (terminado en NULL) y sus tramos
+// (desplazamiento, longitud) dentro del buffer original
+typedef struct {
+    size_t off;
+    size_t len;
+} tSpan;
+
+typedef struct {
+    char **argv;
+    tSpan *spans;
+    int argc;
+    int cap;
+} tArgs;
+
+void args_init(tArgs *a);
+void args_free(tArgs *a);
 
-// Trocea la entrada por teclado en argumentos
-int chopString(char * argc, char * argv[]);
+// Lee un comando, lo añade al historial y lo trocea en args
+char *readCommand(char *command, bool read, tArgs *args);
+
+// Trocea la línea en una sola pasada, in situ: separa por blancos,
+// respeta '...' y "..." y admite escapes con '\'. Devuelve argc o -1
+int tokenize(char *line, tArgs *out);
+
+// Reconstruye argv a partir de argumentos ya troceados ('\0' entre ellos)
+int args_from_blob(char *blob, int argc, tArgs *out);
 
 // Procesa el comando y ejecuta
 int processCommand(int argc, char *argv[]);
 
+// Añade un comando en tiempo de ejecución (name y help deben perdurar);
+// se resuelve en O(1) tras la tabla hash perfecta generada
+int commands_register(const char *name, command_fn func, const char *help);
+
 // Procesa el historial de comandos
 int cmd_historic(int argc, char *argv[]);
 
 // Vacía el historial de comandos
 void historic_clear(void);
 
-// Borra un comando del historial de comandos
-void delHist(void *item);
-
 // Proporciona información sobre los comandos disponibles
 int cmd_help(int argc, char *argv[]);
 #endif //COMANDOS_H
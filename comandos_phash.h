@@ -0,0 +1,22 @@
+/* Generado por gen_phash a partir de comandos.def: no editar */
+#define CMD_PHASH_SEED 0x000001feu
+#define CMD_PHASH_SIZE 256
+#define CMD_PHASH_COUNT 58
+static const short cmd_phash_slots[CMD_PHASH_SIZE] = {
+    -1, -1, -1, -1, 43, -1, -1, -1, -1, 4, 18, -1, -1, 0, -1, -1,
+    -1, -1, -1, 2, -1, 13, -1, -1, 46, -1, -1, -1, -1, -1, -1, 24,
+    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, 47, -1, -1, -1, -1, -1,
+    25, -1, -1, 42, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+    36, -1, -1, 57, 56, -1, -1, -1, 12, -1, 33, 53, -1, -1, 6, -1,
+    1, -1, -1, -1, -1, 5, -1, 15, -1, 28, -1, -1, -1, -1, -1, -1,
+    -1, -1, 48, -1, -1, -1, -1, 34, 21, 37, -1, -1, -1, -1, -1, -1,
+    54, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, 50, -1, -1, -1, 14,
+    -1, -1, -1, -1, 3, -1, 22, -1, -1, -1, -1, -1, -1, -1, 52, -1,
+    -1, -1, -1, 8, -1, -1, -1, -1, 35, -1, -1, 7, 9, -1, -1, 39,
+    40, 20, -1, -1, -1, -1, -1, 19, -1, -1, -1, -1, -1, 41, -1, -1,
+    11, -1, -1, 17, -1, -1, 29, 38, -1, -1, -1, -1, -1, -1, -1, -1,
+    -1, -1, 16, -1, -1, -1, 26, -1, 45, -1, 30, -1, 49, -1, -1, 44,
+    27, -1, -1, 31, -1, -1, -1, -1, -1, 10, -1, -1, -1, -1, -1, -1,
+    -1, -1, -1, -1, 55, -1, -1, -1, 51, -1, -1, -1, 23, -1, -1, -1,
+    -1, -1, -1, -1, -1, -1, -1, -1, -1, 32, -1, -1, -1, -1, -1, -1,
+};
@@ -0,0 +1,490 @@
+// Pablo Araújo Rodríguez   pablo.araujo@udc.es
+// Uriel Liñares Vaamonde   uriel.linaresv@udc.es
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "contenedores.h"
+
+/* ---------------------------- Vector ---------------------------- */
+
+void vector_init(tVector *v, size_t elem_size) {
+    v->data = NULL;
+    v->len = 0;
+    v->cap = 0;
+    v->elem_size = elem_size;
+}
+
+void vector_free(tVector *v) {
+    if (!v) return;
+    free(v->data);
+    v->data = NULL;
+    v->len = v->cap = 0;
+}
+
+void vector_clear(tVector *v) {
+    if (v) v->len = 0;
+}
+
+int vector_reserve(tVector *v, size_t cap) {
+    if (cap <= v->cap) return 0;
+    size_t ncap = v->cap ? v->cap : 16;
+    while (ncap < cap) ncap *= 2;
+    unsigned char *nd = realloc(v->data, ncap * v->elem_size);
+    if (!nd) return -1;
+    v->data = nd;
+    v->cap = ncap;
+    return 0;
+}
+
+void *vector_push(tVector *v, const void *elem) {
+    if (v->len == v->cap && vector_reserve(v, v->len + 1) != 0) return NULL;
+    void *slot = v->data + v->len * v->elem_size;
+    if (elem) memcpy(slot, elem, v->elem_size);
+    else memset(slot, 0, v->elem_size);
+    v->len++;
+    return slot;
+}
+
+void *vector_at(const tVector *v, size_t i) {
+    if (!v || i >= v->len) return NULL;
+    return v->data + i * v->elem_size;
+}
+
+void vector_remove_swap(tVector *v, size_t i) {
+    if (i >= v->len) return;
+    v->len--;
+    if (i != v->len)
+        memcpy(v->data + i * v->elem_size, v->data + v->len * v->elem_size,
+               v->elem_size);
+}
+
+void vector_pop(tVector *v) {
+    if (v->len) v->len--;
+}
+
+/* ---------------------------- Hash map ---------------------------- */
+
+static uint64_t fix_hash(uint64_t h) { return h ? h : 1; }
+
+void hashmap_init(tHashMap *m, hash_fn hash, eq_fn eq) {
+    m->slots = NULL;
+    m->cap = 0;
+    m->len = 0;
+    m->hash = hash;
+    m->eq = eq;
+}
+
+void hashmap_free(tHashMap *m) {
+    if (!m) return;
+    free(m->slots);
+    m->slots = NULL;
+    m->cap = m->len = 0;
+}
+
+void hashmap_clear(tHashMap *m) {
+    if (!m || !m->slots) return;
+    memset(m->slots, 0, m->cap * sizeof *m->slots);
+    m->len = 0;
+}
+
+static int hashmap_grow(tHashMap *m) {
+    size_t ncap = m->cap ? m->cap * 2 : 16;
+    tHashSlot *ns = calloc(ncap, sizeof *ns);
+    if (!ns) return -1;
+    for (size_t i = 0; i < m->cap; ++i) {
+        if (!m->slots[i].hash) continue;
+        size_t j = (size_t)m->slots[i].hash & (ncap - 1);
+        while (ns[j].hash) j = (j + 1) & (ncap - 1);
+        ns[j] = m->slots[i];
+    }
+    free(m->slots);
+    m->slots = ns;
+    m->cap = ncap;
+    return 0;
+}
+
+static tHashSlot *hashmap_find(const tHashMap *m, const void *key,
+                               uint64_t h) {
+    if (!m->cap) return NULL;
+    size_t mask = m->cap - 1;
+    for (size_t j = (size_t)h & mask; m->slots[j].hash; j = (j + 1) & mask) {
+        if (m->slots[j].hash == h && m->eq(m->slots[j].key, key))
+            return &m->slots[j];
+    }
+    return NULL;
+}
+
+int hashmap_put(tHashMap *m, const void *key, void *value) {
+    uint64_t h = fix_hash(m->hash(key));
+    tHashSlot *s = hashmap_find(m, key, h);
+    if (s) { s->key = key; s->value = value; return 0; }
+    // Factor de carga máximo 3/4
+    if ((m->len + 1) * 4 > m->cap * 3 && hashmap_grow(m) != 0) return -1;
+    size_t mask = m->cap - 1;
+    size_t j = (size_t)h & mask;
+    while (m->slots[j].hash) j = (j + 1) & mask;
+    m->slots[j].hash = h;
+    m->slots[j].key = key;
+    m->slots[j].value = value;
+    m->len++;
+    return 0;
+}
+
+void *hashmap_get(const tHashMap *m, const void *key) {
+    tHashSlot *s = hashmap_find(m, key, fix_hash(m->hash(key)));
+    return s ? s->value : NULL;
+}
+
+bool hashmap_contains(const tHashMap *m, const void *key) {
+    return hashmap_find(m, key, fix_hash(m->hash(key))) != NULL;
+}
+
+void *hashmap_remove(tHashMap *m, const void *key) {
+    tHashSlot *s = hashmap_find(m, key, fix_hash(m->hash(key)));
+    if (!s) return NULL;
+    void *value = s->value;
+    size_t mask = m->cap - 1;
+    size_t i = (size_t)(s - m->slots);
+    // Desplaza hacia atrás los elementos del mismo grupo de sondeo
+    for (size_t j = (i + 1) & mask; m->slots[j].hash; j = (j + 1) & mask) {
+        size_t home = (size_t)m->slots[j].hash & mask;
+        if (((j - home) & mask) >= ((j - i) & mask)) {
+            m->slots[i] = m->slots[j];
+            i = j;
+        }
+    }
+    memset(&m->slots[i], 0, sizeof m->slots[i]);
+    m->len--;
+    return value;
+}
+
+tHashSlot *hashmap_next(const tHashMap *m, size_t *it) {
+    for (; *it < m->cap; ++*it) {
+        if (m->slots[*it].hash) return &m->slots[(*it)++];
+    }
+    return NULL;
+}
+
+uint64_t hash_ptr(const void *key) {
+    uint64_t x = (uint64_t)(uintptr_t)key;
+    // Mezclador de splitmix64
+    x ^= x >> 30; x *= 0xbf58476d1ce4e5b9ULL;
+    x ^= x >> 27; x *= 0x94d049bb133111ebULL;
+    x ^= x >> 31;
+    return x;
+}
+
+bool eq_ptr(const void *a, const void *b) { return a == b; }
+
+uint64_t hash_str(const void *key) {
+    // FNV-1a de 64 bits
+    uint64_t h = 0xcbf29ce484222325ULL;
+    for (const unsigned char *s = key; *s; ++s) {
+        h ^= *s;
+        h *= 0x100000001b3ULL;
+    }
+    return h;
+}
+
+bool eq_str(const void *a, const void *b) { return strcmp(a, b) == 0; }
+
+/* ---------------------------- Pool ---------------------------- */
+
+void pool_init(tPool *p, size_t elem_size, size_t per_slab) {
+    if (elem_size < sizeof(void *)) elem_size = sizeof(void *);
+    p->elem_size = elem_size;
+    p->per_slab = per_slab ? per_slab : 256;
+    p->free_list = NULL;
+    p->slabs = NULL;
+    p->nslabs = 0;
+    p->slabs_cap = 0;
+    p->live = 0;
+}
+
+static int pool_add_slab(tPool *p) {
+    if (p->nslabs == p->slabs_cap) {
+        size_t ncap = p->slabs_cap ? p->slabs_cap * 2 : 8;
+        void **ns = realloc(p->slabs, ncap * sizeof *ns);
+        if (!ns) return -1;
+        p->slabs = ns;
+        p->slabs_cap = ncap;
+    }
+    unsigned char *slab = malloc(p->elem_size * p->per_slab);
+    if (!slab) return -1;
+    p->slabs[p->nslabs++] = slab;
+    // Encadena los huecos del nuevo bloque en la lista libre
+    for (size_t i = p->per_slab; i-- > 0;) {
+        void *elem = slab + i * p->elem_size;
+        *(void **)elem = p->free_list;
+        p->free_list = elem;
+    }
+    return 0;
+}
+
+void *pool_alloc(tPool *p) {
+    if (!p->free_list && pool_add_slab(p) != 0) return NULL;
+    void *elem = p->free_list;
+    p->free_list = *(void **)elem;
+    p->live++;
+    return elem;
+}
+
+void pool_release(tPool *p, void *elem) {
+    if (!elem) return;
+    *(void **)elem = p->free_list;
+    p->free_list = elem;
+    p->live--;
+}
+
+void pool_destroy(tPool *p) {
+    for (size_t i = 0; i < p->nslabs; ++i) free(p->slabs[i]);
+    free(p->slabs);
+    p->slabs = NULL;
+    p->nslabs = p->slabs_cap = 0;
+    p->free_list = NULL;
+    p->live = 0;
+}
+
+/* ---------------------------- Range map (AVL) ---------------------------- */
+
+void rangemap_init(tRangeMap *m) {
+    m->root = NULL;
+    m->len = 0;
+    pool_init(&m->pool, sizeof(tRangeNode), 256);
+}
+
+void rangemap_free(tRangeMap *m) {
+    pool_destroy(&m->pool);
+    m->root = NULL;
+    m->len = 0;
+}
+
+static int rn_height(const tRangeNode *n) { return n ? n->height : 0; }
+
+static void rn_update(tRangeNode *n) {
+    int hl = rn_height(n->left), hr = rn_height(n->right);
+    n->height = 1 + (hl > hr ? hl : hr);
+}
+
+static tRangeNode *rn_rotate_right(tRangeNode *n) {
+    tRangeNode *l = n->left;
+    n->left = l->right;
+    l->right = n;
+    rn_update(n);
+    rn_update(l);
+    return l;
+}
+
+static tRangeNode *rn_rotate_left(tRangeNode *n) {
+    tRangeNode *r = n->right;
+    n->right = r->left;
+    r->left = n;
+    rn_update(n);
+    rn_update(r);
+    return r;
+}
+
+static tRangeNode *rn_balance(tRangeNode *n) {
+    rn_update(n);
+    int bf = rn_height(n->left) - rn_height(n->right);
+    if (bf > 1) {
+        if (rn_height(n->left->left) < rn_height(n->left->right))
+            n->left = rn_rotate_left(n->left);
+        return rn_rotate_right(n);
+    }
+    if (bf < -1) {
+        if (rn_height(n->right->right) < rn_height(n->right->left))
+            n->right = rn_rotate_right(n->right);
+        return rn_rotate_left(n);
+    }
+    return n;
+}
+
+static tRangeNode *rn_insert(tRangeNode *n, tRangeNode *nuevo) {
+    if (!n) return nuevo;
+    if (nuevo->start < n->start) n->left = rn_insert(n->left, nuevo);
+    else n->right = rn_insert(n->right, nuevo);
+    return rn_balance(n);
+}
+
+int rangemap_insert(tRangeMap *m, uintptr_t start, size_t size, int kind,
+                    void *data) {
+    tRangeNode *n = rangemap_find(m, start);
+    if (n) { n->size = size; n->kind = kind; n->data = data; return 0; }
+    n = pool_alloc(&m->pool);
+    if (!n) return -1;
+    n->start = start;
+    n->size = size;
+    n->kind = kind;
+    n->data = data;
+    n->left = n->right = NULL;
+    n->height = 1;
+    m->root = rn_insert(m->root, n);
+    m->len++;
+    return 0;
+}
+
+tRangeNode *rangemap_find(const tRangeMap *m, uintptr_t start) {
+    tRangeNode *n = m->root;
+    while (n && n->start != start) n = start < n->start ? n->left : n->right;
+    return n;
+}
+
+tRangeNode *rangemap_floor(const tRangeMap *m, uintptr_t addr) {
+    tRangeNode *best = NULL;
+    for (tRangeNode *n = m->root; n;) {
+        if (n->start <= addr) { best = n; n = n->right; }
+        else n = n->left;
+    }
+    return best;
+}
+
+static tRangeNode *rn_remove_min(tRangeNode *n, tRangeNode **min) {
+    if (!n->left) { *min = n; return n->right; }
+    n->left = rn_remove_min(n->left, min);
+    return rn_balance(n);
+}
+
+static tRangeNode *rn_remove(tRangeNode *n, uintptr_t start,
+                             tRangeNode **removed) {
+    if (!n) return NULL;
+    if (start < n->start) n->left = rn_remove(n->left, start, removed);
+    else if (start > n->start) n->right = rn_remove(n->right, start, removed);
+    else {
+        *removed = n;
+        if (!n->left) return n->right;
+        if (!n->right) return n->left;
+        tRangeNode *min = NULL;
+        tRangeNode *right = rn_remove_min(n->right, &min);
+        min->left = n->left;
+        min->right = right;
+        return rn_balance(min);
+    }
+    return rn_balance(n);
+}
+
+int rangemap_remove(tRangeMap *m, uintptr_t start) {
+    tRangeNode *removed = NULL;
+    m->root = rn_remove(m->root, start, &removed);
+    if (!removed) return -1;
+    pool_release(&m->pool, removed);
+    m->len--;
+    return 0;
+}
+
+/* ---------------------------- Cadena dinámica ---------------------------- */
+
+void strbuf_init(tStrBuf *b) {
+    b->data = NULL;
+    b->len = 0;
+    b->cap = 0;
+}
+
+void strbuf_free(tStrBuf *b) {
+    free(b->data);
+    strbuf_init(b);
+}
+
+void strbuf_clear(tStrBuf *b) {
+    b->len = 0;
+    if (b->data) b->data[0] = '\0';
+}
+
+static int strbuf_reserve(tStrBuf *b, size_t extra) {
+    if (b->len + extra + 1 <= b->cap) return 0;
+    size_t ncap = b->cap ? b->cap : 256;
+    while (ncap < b->len + extra + 1) ncap *= 2;
+    char *nd = realloc(b->data, ncap);
+    if (!nd) return -1;
+    b->data = nd;
+    b->cap = ncap;
+    return 0;
+}
+
+int strbuf_append(tStrBuf *b, const char *s, size_t n) {
+    if (strbuf_reserve(b, n) != 0) return -1;
+    memcpy(b->data + b->len, s, n);
+    b->len += n;
+    b->data[b->len] = '\0';
+    return 0;
+}
+
+int strbuf_putc(tStrBuf *b, char c) {
+    return strbuf_append(b, &c, 1);
+}
+
+int strbuf_printf(tStrBuf *b, const char *fmt, ...) {
+    va_list ap;
+    va_start(ap, fmt);
+    int n = vsnprintf(b->data ? b->data + b->len : NULL,
+                      b->data ? b->cap - b->len : 0, fmt, ap);
+    va_end(ap);
+    if (n < 0) return -1;
+    if (b->data && b->len + (size_t)n < b->cap) {
+        b->len += (size_t)n;
+        return 0;
+    }
+    // No cabía: reservamos y formateamos de nuevo
+    if (strbuf_reserve(b, (size_t)n) != 0) return -1;
+    va_start(ap, fmt);
+    vsnprintf(b->data + b->len, b->cap - b->len, fmt, ap);
+    va_end(ap);
+    b->len += (size_t)n;
+    return 0;
+}
+
+int strbuf_pad(tStrBuf *b, const char *s, size_t n, int width) {
+    size_t w = (size_t)(width < 0 ? -width : width);
+    size_t fill = w > n ? w - n : 0;
+    if (strbuf_reserve(b, n + fill) != 0) return -1;
+    char *d = b->data + b->len;
+    if (width > 0) { memset(d, ' ', fill); d += fill; }
+    memcpy(d, s, n);
+    d += n;
+    if (width < 0) { memset(d, ' ', fill); d += fill; }
+    b->len += n + fill;
+    b->data[b->len] = '\0';
+    return 0;
+}
+
+int strbuf_num(tStrBuf *b, long long v, int width) {
+    char tmp[24];
+    char *p = tmp + sizeof tmp;
+    // Por magnitud sin signo, para que LLONG_MIN no desborde
+    unsigned long long u = v < 0 ? 0ull - (unsigned long long)v
+                                 : (unsigned long long)v;
+    do { *--p = (char)('0' + u % 10); u /= 10; } while (u);
+    if (v < 0) *--p = '-';
+    return strbuf_pad(b, p, (size_t)(tmp + sizeof tmp - p), width);
+}
+
+/* ---------------------------- Ordenación radix ---------------------------- */
+
+int radix_sort(tSortKey *v, size_t n) {
+    if (n < 2) return 0;
+    tSortKey *tmp = malloc(n * sizeof *tmp);
+    if (!tmp) return -1;
+    // Histogramas de los 8 bytes en una sola lectura
+    size_t count[8][256];
+    memset(count, 0, sizeof count);
+    for (size_t i = 0; i < n; ++i)
+        for (int b = 0; b < 8; ++b) count[b][(v[i].key >> (8 * b)) & 0xff]++;
+    tSortKey *src = v, *dst = tmp;
+    for (int b = 0; b < 8; ++b) {
+        size_t *c = count[b];
+        if (c[(src[0].key >> (8 * b)) & 0xff] == n) continue;
+        size_t pos = 0;
+        for (int d = 0; d < 256; ++d) {
+            size_t k = c[d];
+            c[d] = pos;
+            pos += k;
+        }
+        for (size_t i = 0; i < n; ++i)
+            dst[c[(src[i].key >> (8 * b)) & 0xff]++] = src[i];
+        tSortKey *t = src; src = dst; dst = t;
+    }
+    if (src != v) memcpy(v, src, n * sizeof *v);
+    free(tmp);
+    return 0;
+}
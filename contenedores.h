@@ -0,0 +1,138 @@
+// Pablo Araújo Rodríguez   pablo.araujo@udc.es
+// Uriel Liñares Vaamonde   uriel.linaresv@udc.es
+
+#ifndef CONTENEDORES_H
+#define CONTENEDORES_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdarg.h>
+
+// Vector dinámico contiguo de elementos de tamaño fijo
+typedef struct {
+    unsigned char *data;
+    size_t len;
+    size_t cap;
+    size_t elem_size;
+} tVector;
+
+void vector_init(tVector *v, size_t elem_size);
+void vector_free(tVector *v);
+void vector_clear(tVector *v);
+int vector_reserve(tVector *v, size_t cap);
+// Añade un hueco al final y devuelve su dirección (NULL si no hay memoria)
+void *vector_push(tVector *v, const void *elem);
+void *vector_at(const tVector *v, size_t i);
+void vector_remove_swap(tVector *v, size_t i);
+void vector_pop(tVector *v);
+
+// Tabla hash de direccionamiento abierto (sondeo lineal, borrado por
+// desplazamiento hacia atrás, sin lápidas)
+typedef uint64_t (*hash_fn)(const void *key);
+typedef bool (*eq_fn)(const void *a, const void *b);
+
+typedef struct {
+    uint64_t hash;      // 0 = hueco libre
+    const void *key;
+    void *value;
+} tHashSlot;
+
+typedef struct {
+    tHashSlot *slots;
+    size_t cap;         // potencia de dos
+    size_t len;
+    hash_fn hash;
+    eq_fn eq;
+} tHashMap;
+
+void hashmap_init(tHashMap *m, hash_fn hash, eq_fn eq);
+void hashmap_free(tHashMap *m);
+void hashmap_clear(tHashMap *m);
+int hashmap_put(tHashMap *m, const void *key, void *value);
+void *hashmap_get(const tHashMap *m, const void *key);
+bool hashmap_contains(const tHashMap *m, const void *key);
+// Elimina la clave; devuelve el valor asociado (NULL si no existía)
+void *hashmap_remove(tHashMap *m, const void *key);
+// Iteración: devuelve el siguiente hueco ocupado a partir de *it
+tHashSlot *hashmap_next(const tHashMap *m, size_t *it);
+
+uint64_t hash_ptr(const void *key);
+bool eq_ptr(const void *a, const void *b);
+uint64_t hash_str(const void *key);
+bool eq_str(const void *a, const void *b);
+
+// Pool de nodos de tamaño fijo reservados por bloques (slabs)
+typedef struct {
+    size_t elem_size;
+    size_t per_slab;
+    void *free_list;
+    void **slabs;
+    size_t nslabs;
+    size_t slabs_cap;
+    size_t live;
+} tPool;
+
+void pool_init(tPool *p, size_t elem_size, size_t per_slab);
+void *pool_alloc(tPool *p);
+void pool_release(tPool *p, void *elem);
+void pool_destroy(tPool *p);
+
+// Índice ordenado de rangos de direcciones (árbol AVL por dirección de
+// inicio). Los rangos no se solapan; cada uno lleva una etiqueta de tipo.
+typedef struct tRangeNode {
+    uintptr_t start;
+    size_t size;
+    int kind;
+    void *data;
+    struct tRangeNode *left;
+    struct tRangeNode *right;
+    int height;
+} tRangeNode;
+
+typedef struct {
+    tRangeNode *root;
+    size_t len;
+    tPool pool;
+} tRangeMap;
+
+void rangemap_init(tRangeMap *m);
+void rangemap_free(tRangeMap *m);
+int rangemap_insert(tRangeMap *m, uintptr_t start, size_t size, int kind,
+                    void *data);
+tRangeNode *rangemap_find(const tRangeMap *m, uintptr_t start);
+// Rango con mayor inicio <= addr (NULL si no hay ninguno)
+tRangeNode *rangemap_floor(const tRangeMap *m, uintptr_t addr);
+int rangemap_remove(tRangeMap *m, uintptr_t start);
+
+// Cadena dinámica para acumular salida formateada
+typedef struct {
+    char *data;
+    size_t len;
+    size_t cap;
+} tStrBuf;
+
+void strbuf_init(tStrBuf *b);
+void strbuf_free(tStrBuf *b);
+void strbuf_clear(tStrBuf *b);
+int strbuf_append(tStrBuf *b, const char *s, size_t n);
+int strbuf_putc(tStrBuf *b, char c);
+int strbuf_printf(tStrBuf *b, const char *fmt, ...)
+    __attribute__((format(printf, 2, 3)));
+// Campos de ancho fijo sin pasar por printf: width > 0 alinea a la
+// derecha y width < 0 a la izquierda, como "%*s" y "%*lld"
+int strbuf_pad(tStrBuf *b, const char *s, size_t n, int width);
+int strbuf_num(tStrBuf *b, long long v, int width);
+
+/* Ordenación radix LSD estable por clave de 64 bits, byte a byte; se
+ * saltan las pasadas en las que todas las claves comparten el byte. idx
+ * lleva el elemento al que pertenece cada clave. */
+typedef struct {
+    uint64_t key;
+    size_t idx;
+} tSortKey;
+
+// -1 si no hay memoria para el buffer auxiliar (v queda sin ordenar)
+int radix_sort(tSortKey *v, size_t n);
+
+#endif //CONTENEDORES_H
@@ -0,0 +1,268 @@
+// Pablo Araújo Rodríguez   pablo.araujo@udc.es
+// Uriel Liñares Vaamonde   uriel.linaresv@udc.es
+
+#define _GNU_SOURCE
+#include <errno.h>
+#include <fcntl.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#ifdef __linux__
+#include <sys/sendfile.h>
+#endif
+#include "copia.h"
+
+// Por llamada; el kernel recorta cada una a algo menos de 2 GiB
+#define COPY_CHUNK (1u << 30)
+#define PIPE_SIZE (1u << 20)
+#define BUF_SIZE (1u << 20)
+
+static const char *const method_names[] = {
+    "copy_file_range", "sendfile", "splice", "read/write"
+};
+
+const char *copia_method_name(copy_method_t m) {
+    return method_names[m];
+}
+
+// Errores que indican que el método no sirve para este par de descriptores
+static bool unsupported(int err) {
+    return err == EINVAL || err == ENOSYS || err == EXDEV ||
+           err == EOPNOTSUPP || err == EBADF || err == ESPIPE;
+}
+
+static int write_all(int fd, const char *p, size_t n) {
+    while (n) {
+        ssize_t w = write(fd, p, n);
+        if (w < 0) {
+            if (errno == EINTR) continue;
+            return -1;
+        }
+        p += w;
+        n -= (size_t)w;
+    }
+    return 0;
+}
+
+/* Cada método devuelve 1 si terminó (EOF), 0 si no sirve y hay que pasar
+ * al siguiente (sin haber perdido nada) o -1 ante un error real */
+#ifdef __linux__
+static int by_range(int in, int out, long long *total) {
+    for (bool first = true;; first = false) {
+        ssize_t n = copy_file_range(in, NULL, out, NULL, COPY_CHUNK, 0);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            return first && unsupported(errno) ? 0 : -1;
+        }
+        /* procfs y sysfs dicen tamaño 0 y copy_file_range no copia nada:
+         * un 0 de entrada se confirma con otro método (como cp) */
+        if (n == 0) return first ? 0 : 1;
+        *total += n;
+    }
+}
+
+static int by_sendfile(int in, int out, long long *total) {
+    for (bool first = true;; first = false) {
+        ssize_t n = sendfile(out, in, NULL, COPY_CHUNK);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            return first && unsupported(errno) ? 0 : -1;
+        }
+        if (n == 0) return first ? 0 : 1;
+        *total += n;
+    }
+}
+
+// Saca n bytes de la tubería con read/write
+static int pipe_drain(int rfd, int out, size_t n) {
+    char buf[65536];
+    while (n) {
+        ssize_t r = read(rfd, buf, n < sizeof buf ? n : sizeof buf);
+        if (r < 0 && errno == EINTR) continue;
+        if (r <= 0) { if (r == 0) errno = EIO; return -1; }
+        if (write_all(out, buf, (size_t)r) != 0) return -1;
+        n -= (size_t)r;
+    }
+    return 0;
+}
+
+static int by_splice(int in, int out, long long *total) {
+    int p[2];
+    if (pipe2(p, O_CLOEXEC) != 0) return 0;
+    fcntl(p[1], F_SETPIPE_SZ, (int)PIPE_SIZE);   // si no se puede, 64 KiB
+    int res = 1;
+    for (bool first = true; res == 1; first = false) {
+        ssize_t n = splice(in, NULL, p[1], NULL, PIPE_SIZE, SPLICE_F_MOVE);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            res = first && unsupported(errno) ? 0 : -1;
+            break;
+        }
+        if (n == 0) { if (first) res = 0; break; }
+        // Lo que entró en la tubería tiene que salir entero
+        ssize_t left = n;
+        while (left > 0) {
+            ssize_t w = splice(p[0], NULL, out, NULL, (size_t)left,
+                               SPLICE_F_MOVE);
+            if (w < 0 && errno == EINTR) continue;
+            if (w > 0) { left -= w; continue; }
+            if (w == 0) errno = EIO;
+            /* La salida no admite splice: se vacía la tubería a mano y
+             * sigue el bucle con buffer */
+            if (first && left == n && unsupported(errno))
+                res = pipe_drain(p[0], out, (size_t)n) == 0 ? 0 : -1;
+            else
+                res = -1;
+            break;
+        }
+        if (res != -1) *total += n;
+    }
+    int e = errno;
+    close(p[0]);
+    close(p[1]);
+    errno = e;
+    return res;
+}
+#endif
+
+static int by_buffer(int in, int out, long long *total) {
+    char *buf = malloc(BUF_SIZE);
+    if (!buf) return -1;
+    int res = 1;
+    for (;;) {
+        ssize_t n = read(in, buf, BUF_SIZE);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            res = -1;
+            break;
+        }
+        if (n == 0) break;
+        if (write_all(out, buf, (size_t)n) != 0) { res = -1; break; }
+        *total += n;
+    }
+    int e = errno;
+    free(buf);
+    errno = e;
+    return res;
+}
+
+long long copia_fd(int in, int out, copy_method_t *method) {
+    long long total = 0;
+    int r = 0;
+#ifdef __linux__
+    static int (*const methods[])(int, int, long long *) = {
+        by_range, by_sendfile, by_splice
+    };
+    for (copy_method_t m = COPY_RANGE; m < COPY_BUFFER; ++m) {
+        *method = m;
+        r = methods[m](in, out, &total);
+        if (r != 0) return r < 0 ? -1 : total;
+    }
+#endif
+    *method = COPY_BUFFER;
+    r = by_buffer(in, out, &total);
+    return r < 0 ? -1 : total;
+}
+
+/* ------------------------- hacia memoria ------------------------- */
+
+// Trozo por read(); el siguiente se pide por adelantado con readahead()
+#define READ_CHUNK (8u << 20)
+// Alineación que O_DIRECT exige a dirección, tamaño y posición
+#define DIO_ALIGN 4096u
+#define DIO_BOUNCE (4u << 20)
+
+static long long read_buffered(int in, char *dst, size_t len) {
+    struct stat sb;
+    bool regular = fstat(in, &sb) == 0 && S_ISREG(sb.st_mode);
+    off_t pos = regular ? lseek(in, 0, SEEK_CUR) : -1;
+    if (pos >= 0) posix_fadvise(in, pos, (off_t)len, POSIX_FADV_SEQUENTIAL);
+    size_t done = 0;
+    while (done < len) {
+        size_t n = len - done;
+        if (n > READ_CHUNK) n = READ_CHUNK;
+#ifdef __linux__
+        // Mientras se copia este trozo, el disco ya va leyendo el siguiente
+        size_t next = len - done - n;
+        if (pos >= 0 && next)
+            readahead(in, pos + (off_t)(done + n),
+                      next < READ_CHUNK ? next : READ_CHUNK);
+#endif
+        ssize_t k = read(in, dst + done, n);
+        if (k < 0) {
+            if (errno == EINTR) continue;
+            return -1;
+        }
+        if (k == 0) break;
+        done += (size_t)k;
+    }
+    return (long long)done;
+}
+
+#ifdef O_DIRECT
+/* Directo a dst cuando está alineado; si no (o para el último trozo, que
+ * se redondea hacia arriba) a través de un buffer alineado. La posición
+ * solo avanza en múltiplos de DIO_ALIGN salvo al llegar a EOF. */
+static long long read_direct(int in, char *dst, size_t len) {
+    char *bounce = NULL;
+    size_t done = 0;
+    int err = 0;
+    while (done < len) {
+        size_t want = len - done;
+        char *to = dst + done;
+        size_t n;
+        bool via_bounce = ((uintptr_t)to % DIO_ALIGN) != 0 || want < DIO_ALIGN;
+        if (via_bounce) {
+            if (!bounce && posix_memalign((void **)&bounce, DIO_ALIGN,
+                                          DIO_BOUNCE) != 0) {
+                err = ENOMEM;
+                break;
+            }
+            n = want < DIO_BOUNCE ? (want + DIO_ALIGN - 1) & ~(size_t)(DIO_ALIGN - 1)
+                                  : DIO_BOUNCE;
+            to = bounce;
+        } else {
+            n = want & ~(size_t)(DIO_ALIGN - 1);
+            if (n > COPY_CHUNK) n = COPY_CHUNK;
+        }
+        ssize_t k = read(in, to, n);
+        if (k < 0) {
+            if (errno == EINTR) continue;
+            err = errno;
+            break;
+        }
+        size_t got = (size_t)k < want ? (size_t)k : want;
+        if (via_bounce) memcpy(dst + done, bounce, got);
+        done += got;
+        // Un trozo no alineado solo llega en EOF
+        if (k == 0 || (size_t)k % DIO_ALIGN != 0) break;
+    }
+    free(bounce);
+    if (err) {
+        errno = err;
+        return done ? (long long)done : -1;
+    }
+    return (long long)done;
+}
+#endif
+
+long long copia_a_memoria(int in, void *dst, size_t len, bool *direct) {
+#ifdef O_DIRECT
+    int fl = *direct ? fcntl(in, F_GETFL) : -1;
+    if (fl != -1 && fcntl(in, F_SETFL, fl | O_DIRECT) == 0) {
+        long long n = read_direct(in, dst, len);
+        int e = errno;
+        fcntl(in, F_SETFL, fl);
+        // EINVAL en la primera lectura: el FS acepta la marca pero no la usa
+        if (n != -1 || e != EINVAL) {
+            errno = e;
+            return n;
+        }
+    }
+#endif
+    *direct = false;
+    return read_buffered(in, dst, len);
+}
@@ -0,0 +1,29 @@
+// Pablo Araújo Rodríguez   pablo.araujo@udc.es
+// Uriel Liñares Vaamonde   uriel.linaresv@udc.es
+
+#ifndef COPIA_H
+#define COPIA_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+/* Copia entre descriptores sin pasar los datos por espacio de usuario:
+ * copy_file_range() (el FS puede compartir bloques, reflink), luego
+ * sendfile(), luego splice() a través de una tubería y, solo si nada de
+ * eso vale para el par de descriptores, un bucle read/write con un buffer
+ * grande. Se copia desde la posición actual de in hasta su final y ambas
+ * posiciones avanzan, como con read/write. */
+
+typedef enum { COPY_RANGE, COPY_SENDFILE, COPY_SPLICE, COPY_BUFFER } copy_method_t;
+
+// Bytes copiados o -1 con errno; *method queda con el último método usado
+long long copia_fd(int in, int out, copy_method_t *method);
+const char *copia_method_name(copy_method_t m);
+
+/* Lee de in a dst hasta len bytes o EOF, avisando al kernel de que la
+ * lectura es secuencial. Con *direct se intenta O_DIRECT (sin pasar por la
+ * caché de páginas) en trozos alineados; si el FS no lo admite se lee
+ * normal y *direct queda a false. Bytes leídos o -1 con errno. */
+long long copia_a_memoria(int in, void *dst, size_t len, bool *direct);
+
+#endif //COPIA_H
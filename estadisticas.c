@@ -0,0 +1,192 @@
+// Pablo Araújo Rodríguez   pablo.araujo@udc.es
+// Uriel Liñares Vaamonde   uriel.linaresv@udc.es
+
+#define _POSIX_C_SOURCE 200809L
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "estadisticas.h"
+#include "contenedores.h"
+
+typedef struct {
+    char *name;
+    uint64_t calls;
+    uint64_t total_ns;
+    uint64_t max_ns;
+    uint64_t utime_us;
+    uint64_t stime_us;
+    uint64_t minflt;
+    uint64_t majflt;
+    uint32_t hist[STATS_BUCKETS];
+} tCmdStats;
+
+// Nombre de comando -> tCmdStats*
+static tHashMap stats_by_name;
+static bool stats_ready = false;
+
+static uint64_t monotonic_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000u + (uint64_t)ts.tv_nsec;
+}
+
+static uint64_t tv_us(struct timeval tv) {
+    return (uint64_t)tv.tv_sec * 1000000u + (uint64_t)tv.tv_usec;
+}
+
+// Diferencia no negativa (los contadores de hijos solo crecen al esperarlos)
+static uint64_t delta(uint64_t after, uint64_t before) {
+    return after > before ? after - before : 0;
+}
+
+static unsigned bucket_of(uint64_t v) {
+    if (v < STATS_SUB) return (unsigned)v;
+    unsigned e = 63u - (unsigned)__builtin_clzll(v);
+    unsigned sub = (unsigned)(v >> (e - STATS_SUB_BITS)) & (STATS_SUB - 1);
+    return (e - STATS_SUB_BITS + 1) * STATS_SUB + sub;
+}
+
+// Mayor valor que cae en la cubeta b
+static uint64_t bucket_upper(unsigned b) {
+    if (b < STATS_SUB) return b;
+    unsigned e = b / STATS_SUB + STATS_SUB_BITS - 1;
+    uint64_t sub = b % STATS_SUB;
+    uint64_t lo = (1ull << e) | (sub << (e - STATS_SUB_BITS));
+    return lo + (1ull << (e - STATS_SUB_BITS)) - 1;
+}
+
+static uint64_t percentile(const tCmdStats *s, double q) {
+    uint64_t rank = (uint64_t)(q * (double)s->calls + 0.5);
+    if (rank == 0) rank = 1;
+    uint64_t seen = 0;
+    for (unsigned b = 0; b < STATS_BUCKETS; ++b) {
+        seen += s->hist[b];
+        if (seen >= rank) {
+            uint64_t up = bucket_upper(b);
+            return up < s->max_ns ? up : s->max_ns;
+        }
+    }
+    return s->max_ns;
+}
+
+static tCmdStats *stats_for(const char *name) {
+    if (!stats_ready) {
+        hashmap_init(&stats_by_name, hash_str, eq_str);
+        stats_ready = true;
+    }
+    tCmdStats *s = hashmap_get(&stats_by_name, name);
+    if (s) return s;
+    s = calloc(1, sizeof *s);
+    if (!s) return NULL;
+    s->name = strdup(name);
+    if (!s->name || hashmap_put(&stats_by_name, s->name, s) != 0) {
+        free(s->name);
+        free(s);
+        return NULL;
+    }
+    return s;
+}
+
+void stats_begin(tStatsMark *m) {
+    getrusage(RUSAGE_SELF, &m->self);
+    getrusage(RUSAGE_CHILDREN, &m->children);
+    m->wall_ns = monotonic_ns();
+}
+
+void stats_end(const char *name, const tStatsMark *m) {
+    uint64_t wall = delta(monotonic_ns(), m->wall_ns);
+    struct rusage self, children;
+    getrusage(RUSAGE_SELF, &self);
+    getrusage(RUSAGE_CHILDREN, &children);
+
+    tCmdStats *s = stats_for(name);
+    if (!s) return;
+    s->calls++;
+    s->total_ns += wall;
+    if (wall > s->max_ns) s->max_ns = wall;
+    s->hist[bucket_of(wall)]++;
+    s->utime_us += delta(tv_us(self.ru_utime), tv_us(m->self.ru_utime)) +
+                   delta(tv_us(children.ru_utime), tv_us(m->children.ru_utime));
+    s->stime_us += delta(tv_us(self.ru_stime), tv_us(m->self.ru_stime)) +
+                   delta(tv_us(children.ru_stime), tv_us(m->children.ru_stime));
+    s->minflt += delta((uint64_t)self.ru_minflt, (uint64_t)m->self.ru_minflt) +
+                 delta((uint64_t)children.ru_minflt,
+                       (uint64_t)m->children.ru_minflt);
+    s->majflt += delta((uint64_t)self.ru_majflt, (uint64_t)m->self.ru_majflt) +
+                 delta((uint64_t)children.ru_majflt,
+                       (uint64_t)m->children.ru_majflt);
+}
+
+void stats_reset(void) {
+    if (!stats_ready) return;
+    size_t it = 0;
+    for (tHashSlot *s; (s = hashmap_next(&stats_by_name, &it));) {
+        tCmdStats *c = s->value;
+        free(c->name);
+        free(c);
+    }
+    hashmap_clear(&stats_by_name);
+}
+
+void stats_shutdown(void) {
+    stats_reset();
+    if (stats_ready) hashmap_free(&stats_by_name);
+    stats_ready = false;
+}
+
+static int by_total_desc(const void *a, const void *b) {
+    const tCmdStats *x = *(tCmdStats *const *)a, *y = *(tCmdStats *const *)b;
+    if (x->total_ns != y->total_ns) return x->total_ns < y->total_ns ? 1 : -1;
+    return strcmp(x->name, y->name);
+}
+
+static void print_header(void) {
+    printf("%-14s %8s %11s %10s %10s %10s %10s %10s %8s %6s\n", "command",
+           "calls", "total(ms)", "p50(us)", "p99(us)", "max(us)", "user(ms)",
+           "sys(ms)", "minflt", "majflt");
+}
+
+static void print_row(const tCmdStats *s) {
+    printf("%-14s %8llu %11.3f %10.1f %10.1f %10.1f %10.3f %10.3f %8llu "
+           "%6llu\n", s->name, (unsigned long long)s->calls,
+           (double)s->total_ns / 1e6, (double)percentile(s, 0.50) / 1e3,
+           (double)percentile(s, 0.99) / 1e3, (double)s->max_ns / 1e3,
+           (double)s->utime_us / 1e3, (double)s->stime_us / 1e3,
+           (unsigned long long)s->minflt, (unsigned long long)s->majflt);
+}
+
+int cmd_stats(int argc, char *argv[]) {
+    if (argc == 2 && strcmp(argv[1], "-reset") == 0) {
+        stats_reset();
+        return 0;
+    }
+    if (!stats_ready || stats_by_name.len == 0) {
+        printf("No commands recorded\n");
+        return 0;
+    }
+    if (argc > 1) {
+        int status = 0;
+        print_header();
+        for (int i = 1; i < argc; ++i) {
+            const tCmdStats *s = hashmap_get(&stats_by_name, argv[i]);
+            if (s) print_row(s);
+            else {
+                fprintf(stderr, "stats: no data for '%s'\n", argv[i]);
+                status = 1;
+            }
+        }
+        return status;
+    }
+    // Ordenados por tiempo total, del más costoso al más barato
+    size_t n = stats_by_name.len, k = 0, it = 0;
+    tCmdStats **rows = malloc(n * sizeof *rows);
+    if (!rows) { perror("malloc"); return 1; }
+    for (tHashSlot *s; (s = hashmap_next(&stats_by_name, &it));)
+        rows[k++] = s->value;
+    qsort(rows, n, sizeof *rows, by_total_desc);
+    print_header();
+    for (size_t i = 0; i < n; ++i) print_row(rows[i]);
+    free(rows);
+    return 0;
+}
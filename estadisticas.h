@@ -0,0 +1,32 @@
+// Pablo Araújo Rodríguez   pablo.araujo@udc.es
+// Uriel Liñares Vaamonde   uriel.linaresv@udc.es
+
+#ifndef ESTADISTICAS_H
+#define ESTADISTICAS_H
+
+#include <stdint.h>
+#include <sys/resource.h>
+
+/* Histograma log-lineal de latencias en ns: 8 subcubetas por potencia de
+ * dos (error relativo < 12.5%). Los valores < 8 ns tienen cubeta propia. */
+#define STATS_SUB_BITS 3
+#define STATS_SUB (1u << STATS_SUB_BITS)
+#define STATS_BUCKETS ((64 - STATS_SUB_BITS + 1) * STATS_SUB)
+
+// Instantánea tomada al empezar un comando
+typedef struct {
+    uint64_t wall_ns;
+    struct rusage self;
+    struct rusage children;
+} tStatsMark;
+
+void stats_begin(tStatsMark *m);
+// Acumula la diferencia desde m en las estadísticas de name
+void stats_end(const char *name, const tStatsMark *m);
+void stats_reset(void);
+void stats_shutdown(void);
+
+// stats [-reset] [cmd ...]: latencia y recursos por comando
+int cmd_stats(int argc, char *argv[]);
+
+#endif //ESTADISTICAS_H
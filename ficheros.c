@@ -3,35 +3,187 @@
 
 #include "ficheros.h"
 
-static List *open_files = NULL;
+/* Tabla de ficheros abiertos: vector denso indexado por descriptor y un
+ * índice ruta -> descriptor. Los descriptores con la misma ruta (dup) se
+ * encadenan por name_next, el más reciente en cabeza. */
+static tVector open_files;        /* tItemF* por fd, NULL si libre */
+static tHashMap open_by_name;     /* filename -> cabeza de la cadena */
+static size_t open_count = 0;
+static bool open_files_ready = false;
 
 static void ensure_file_list(void) {
-    if (!open_files) open_files = createList();
+    if (open_files_ready) return;
+    vector_init(&open_files, sizeof(tItemF *));
+    hashmap_init(&open_by_name, hash_str, eq_str);
+    open_files_ready = true;
 }
 
 static bool file_list_ready(void) {
-    if (!open_files) {
+    if (!open_files_ready) {
         fprintf(stderr, "Internal error: file list not initialized\n");
         return false;
     }
     return true;
 }
 
+static tItemF *lookup_fd(int fd) {
+    if (fd < 0 || (size_t)fd >= open_files.len) return NULL;
+    return *(tItemF **)vector_at(&open_files, (size_t)fd);
+}
+
+static tItemF *lookup_name(const char *name) {
+    return (tItemF *)hashmap_get(&open_by_name, name);
+}
+
+// IOV_MAX es XSI y no llega con _POSIX_C_SOURCE; en Linux vale 1024
+#ifndef IOV_MAX
+#define IOV_MAX 1024
+#endif
+
+/* Escribe todo el vector en llamadas de hasta IOV_MAX entradas; tras una
+ * escritura parcial se sigue desde el byte exacto en el que se quedó */
+static int writev_all(int fd, struct iovec *iov, size_t cnt){
+    while (cnt > 0) {
+        int n = cnt < IOV_MAX ? (int)cnt : IOV_MAX;
+        ssize_t w = writev(fd, iov, n);
+        if (w == -1) {
+            if (errno == EINTR) continue;
+            return -1;
+        }
+        size_t left = (size_t)w;
+        while (cnt > 0 && left >= iov->iov_len) {
+            left -= iov->iov_len;
+            ++iov; --cnt;
+        }
+        if (cnt > 0) {
+            iov->iov_base = (char *)iov->iov_base + left;
+            iov->iov_len -= left;
+        }
+    }
+    return 0;
+}
+
+/* Buffer de escritura por descriptor (open ... buf=N). Las escrituras
+ * pequeñas se copian al buffer; las que no caben en él vacían lo pendiente
+ * y van directas, para no partirlas ni copiarlas de más. */
+static int item_flush(tItemF *it) {
+    if (!it || it->wlen == 0) return 0;
+    struct iovec iov = { it->wbuf, it->wlen };
+    // Tras un error lo pendiente se descarta, como haría stdio
+    it->wlen = 0;
+    return writev_all(it->fileDescriptor, &iov, 1);
+}
+
+static int item_write_iov(tItemF *it, int fd, struct iovec *iov, size_t cnt,
+                          size_t total) {
+    if (it && it->wbuf) {
+        if (it->wlen + total > it->wcap && item_flush(it) != 0) return -1;
+        if (total < it->wcap) {
+            for (size_t i = 0; i < cnt; ++i) {
+                memcpy(it->wbuf + it->wlen, iov[i].iov_base, iov[i].iov_len);
+                it->wlen += iov[i].iov_len;
+            }
+            if (it->wlen == it->wcap) return item_flush(it);
+            return 0;
+        }
+    }
+    return writev_all(fd, iov, cnt);
+}
+
+ssize_t ficheros_write(int fd, const void *buf, size_t n) {
+    struct iovec iov = { (void *)buf, n };
+    tItemF *it = open_files_ready ? lookup_fd(fd) : NULL;
+    if (!it || !it->wbuf) return write(fd, buf, n);
+    return item_write_iov(it, fd, &iov, 1, n) == 0 ? (ssize_t)n : -1;
+}
+
+int ficheros_flush(int fd) {
+    return open_files_ready ? item_flush(lookup_fd(fd)) : 0;
+}
+
+void ficheros_flush_all(void) {
+    if (!open_files_ready) return;
+    for (size_t fd = 0; fd < open_files.len; ++fd) {
+        tItemF *it = lookup_fd((int)fd);
+        if (item_flush(it) != 0) perror(it->filename);
+    }
+}
+
+static void unregister_file(tItemF *it) {
+    if (!it) return;
+    *(tItemF **)vector_at(&open_files, (size_t)it->fileDescriptor) = NULL;
+    open_count--;
+    tItemF *head = lookup_name(it->filename);
+    if (head == it) {
+        hashmap_remove(&open_by_name, it->filename);
+        // La clave es la propia cadena del item: reinsertar con la nueva cabeza
+        if (it->name_next)
+            hashmap_put(&open_by_name, it->name_next->filename, it->name_next);
+        return;
+    }
+    for (tItemF *p = head; p; p = p->name_next) {
+        if (p->name_next == it) { p->name_next = it->name_next; break; }
+    }
+}
+
+static int register_file(tItemF *it) {
+    size_t fd = (size_t)it->fileDescriptor;
+    while (open_files.len <= fd) {
+        if (!vector_push(&open_files, NULL)) return -1;
+    }
+    tItemF *old = lookup_fd(it->fileDescriptor);
+    if (old) {
+        unregister_file(old);
+        free(old->wbuf);
+        free(old->filename);
+        free(old);
+    }
+    tItemF *head = lookup_name(it->filename);
+    if (head) hashmap_remove(&open_by_name, head->filename);
+    it->name_next = head;
+    if (hashmap_put(&open_by_name, it->filename, it) != 0) {
+        it->name_next = NULL;
+        if (head) hashmap_put(&open_by_name, head->filename, head);
+        return -1;
+    }
+    *(tItemF **)vector_at(&open_files, fd) = it;
+    open_count++;
+    return 0;
+}
+
+static void clear_file_table(void) {
+    for (size_t fd = 0; fd < open_files.len; ++fd) {
+        tItemF *it = lookup_fd((int)fd);
+        if (it) delFile(it);
+    }
+    vector_clear(&open_files);
+    hashmap_clear(&open_by_name);
+    open_count = 0;
+}
+
 void ficheros_init(void) {
     ensure_file_list();
-    clearList(open_files, delFile);
-    insertItem(open_files, make_itemF(STDIN_FILENO,  "stdin",  O_RDONLY));
-    insertItem(open_files, make_itemF(STDOUT_FILENO, "stdout", O_WRONLY));
-    insertItem(open_files, make_itemF(STDERR_FILENO, "stderr", O_WRONLY));
+    clear_file_table();
+    register_file(make_itemF(STDIN_FILENO,  "stdin",  O_RDONLY));
+    register_file(make_itemF(STDOUT_FILENO, "stdout", O_WRONLY));
+    register_file(make_itemF(STDERR_FILENO, "stderr", O_WRONLY));
 }
 
+static void dir_caches_free(void);
+
 void ficheros_shutdown(void) {
-    if (!open_files) return;
-    deleteList(open_files, delFile);
-    open_files = NULL;
+    dir_caches_free();
+    dcache_shutdown();
+    meta_shutdown();
+    if (!open_files_ready) return;
+    clear_file_table();
+    vector_free(&open_files);
+    hashmap_free(&open_by_name);
+    open_files_ready = false;
 }
 
-static DirParams global_dir_params = { false, false, false, DIR_REC_NOREC };
+static DirParams global_dir_params = { false, false, false, DIR_REC_NOREC, 0,
+                                            META_AUTO, DIR_SORT_NONE, false };
 
 const DirParams *dirparams_get(void) { return &global_dir_params; }
 
@@ -56,101 +208,437 @@ static void fmt_mtime(time_t t, char *buf, size_t n){
     }
 }
 
-static int print_one_with_params(const char *path, const DirParams *p){
-    struct stat sb;
-    if (lstat(path, &sb) == -1) { perror(path); return 1; }
-    if (!p->longfmt) {
-        printf("%s\t%lld", path, (long long)sb.st_size);
-        if (p->showlink && S_ISLNK(sb.st_mode)) {
-            char tgt[PATH_MAX];
-            ssize_t n = readlink(path, tgt, sizeof(tgt)-1);
-            if (n >= 0) { tgt[n] = '\0'; printf(" -> %s", tgt); }
+/* La fecha de dir -long solo llega al minuto: cada hilo guarda las últimas
+ * cadenas formateadas en una tabla directa indexada por minuto, sin
+ * cerrojos. Los ficheros de un mismo árbol suelen compartir minutos. */
+#define MTIME_CACHE 64
+
+typedef struct {
+    long long minute;
+    bool valid;
+    char text[24];
+} tMinuteSlot;
+
+static _Thread_local tMinuteSlot mtime_cache[MTIME_CACHE];
+
+static const char *fmt_mtime_cached(time_t t){
+    long long minute = (long long)t / 60 - ((long long)t % 60 < 0);
+    tMinuteSlot *s = &mtime_cache[(unsigned long long)minute % MTIME_CACHE];
+    if (!s->valid || s->minute != minute) {
+        fmt_mtime((time_t)(minute * 60), s->text, sizeof s->text);
+        s->minute = minute;
+        s->valid = true;
+    }
+    return s->text;
+}
+
+// Equivalente a perror() sobre un buffer; strerror_r por ser multihilo
+static void buf_error(tStrBuf *b, const char *what, int err){
+    char msg[128];
+    if (strerror_r(err, msg, sizeof msg) != 0)
+        snprintf(msg, sizeof msg, "error %d", err);
+    strbuf_printf(b, "%s: %s\n", what, msg);
+}
+
+static char *join_path(const char *dir, const char *name){
+    size_t ld = strlen(dir), ln = strlen(name);
+    char *p = malloc(ld + ln + 2);
+    if (!p) return NULL;
+    memcpy(p, dir, ld);
+    p[ld] = '/';
+    memcpy(p + ld + 1, name, ln + 1);
+    return p;
+}
+
+/* Caché de nombres de usuario y grupo (compartida entre hilos). También
+ * se guardan los ids sin nombre para no repetir consultas NSS fallidas.
+ * La consulta se hace fuera del cerrojo; si dos hilos coinciden, gana el
+ * primero en insertar. */
+typedef struct {
+    pthread_mutex_t lock;
+    tHashMap names;         // id -> nombre
+    bool ready;
+} tIdCache;
+
+static tIdCache user_cache = { PTHREAD_MUTEX_INITIALIZER, { 0 }, false };
+static tIdCache group_cache = { PTHREAD_MUTEX_INITIALIZER, { 0 }, false };
+static const char unknown_name[] = "unknown";
+
+static char *nss_name(unsigned id, bool group){
+    size_t size = 1024;
+    char *buf = NULL, *name = NULL;
+    for (;;) {
+        char *nb = realloc(buf, size);
+        if (!nb) break;
+        buf = nb;
+        int rc;
+        if (group) {
+            struct group grp, *gr = NULL;
+            rc = getgrgid_r((gid_t)id, &grp, buf, size, &gr);
+            if (rc == 0 && gr) name = strdup(gr->gr_name);
+        } else {
+            struct passwd pwd, *pw = NULL;
+            rc = getpwuid_r((uid_t)id, &pwd, buf, size, &pw);
+            if (rc == 0 && pw) name = strdup(pw->pw_name);
         }
-        putchar('\n');
-        return 0;
+        // Grupos con muchos miembros necesitan más espacio
+        if (rc != ERANGE || size >= (1u << 20)) break;
+        size *= 2;
+    }
+    free(buf);
+    return name;
+}
+
+static const char *id_name(tIdCache *c, unsigned id, bool group){
+    const void *key = (const void *)(uintptr_t)id;
+    pthread_mutex_lock(&c->lock);
+    if (!c->ready) {
+        hashmap_init(&c->names, hash_ptr, eq_ptr);
+        c->ready = true;
+    }
+    const char *name = hashmap_get(&c->names, key);
+    pthread_mutex_unlock(&c->lock);
+    if (name) return name;
+
+    char *found = nss_name(id, group);
+    const char *val = found ? found : unknown_name;
+    pthread_mutex_lock(&c->lock);
+    const char *prev = hashmap_get(&c->names, key);
+    if (prev || hashmap_put(&c->names, key, (void *)val) != 0) {
+        free(found);
+        val = prev ? prev : unknown_name;
+    }
+    pthread_mutex_unlock(&c->lock);
+    return val;
+}
+
+static void id_cache_free(tIdCache *c){
+    pthread_mutex_lock(&c->lock);
+    if (c->ready) {
+        size_t it = 0;
+        for (tHashSlot *s; (s = hashmap_next(&c->names, &it));)
+            if (s->value != unknown_name) free(s->value);
+        hashmap_free(&c->names);
+        c->ready = false;
+    }
+    pthread_mutex_unlock(&c->lock);
+}
+
+static void dir_caches_free(void){
+    id_cache_free(&user_cache);
+    id_cache_free(&group_cache);
+}
+
+/* Campos que necesita el listado: el modo corto solo usa el tamaño (y el
+ * tipo, que siempre llega) */
+// statx solo garantiza lo pedido: sort=mtime necesita el mtime aunque no se muestre
+static unsigned dir_meta_need(bool longfmt, dir_sort_t sort){
+    unsigned need = sort == DIR_SORT_MTIME ? META_MTIME : 0;
+    if (!longfmt) return need | META_SIZE;
+    return need | META_SIZE | META_MTIME | META_PERMS | META_OWNER | META_NLINK;
+}
+
+/* Una línea de dir para dir/name (o solo name si dir es NULL) según los
+ * parámetros, campo a campo y sin printf; dfd/name localizan la entrada
+ * para readlinkat() */
+static void format_entry(tStrBuf *out, const char *dir, const char *name,
+                         int dfd, const tMeta *m, const DirParams *p){
+    if (p->longfmt) {
+        char perms[12];
+        (void)convertMode(m->mode, perms);
+        const char *user = id_name(&user_cache, (unsigned)m->uid, false);
+        const char *group = id_name(&group_cache, (unsigned)m->gid, true);
+        strbuf_append(out, perms, 11);
+        strbuf_putc(out, ' ');
+        strbuf_num(out, (long long)m->nlink, 3);
+        strbuf_putc(out, ' ');
+        strbuf_pad(out, user, strlen(user), -8);
+        strbuf_putc(out, ' ');
+        strbuf_pad(out, group, strlen(group), -8);
+        strbuf_putc(out, ' ');
+        strbuf_num(out, (long long)m->size, 9);
+        strbuf_putc(out, ' ');
+        const char *when = fmt_mtime_cached(m->mtime);
+        strbuf_append(out, when, strlen(when));
+        strbuf_putc(out, ' ');
+    }
+    if (dir) {
+        strbuf_append(out, dir, strlen(dir));
+        strbuf_putc(out, '/');
+    }
+    strbuf_append(out, name, strlen(name));
+    if (!p->longfmt) {
+        strbuf_putc(out, '\t');
+        strbuf_num(out, (long long)m->size, 0);
     }
-    char perms[12];
-    (void)convertMode(sb.st_mode, perms);
-    struct passwd *pw = getpwuid(sb.st_uid);
-    struct group  *gr = getgrgid(sb.st_gid);
-    char tbuf[64];
-    fmt_mtime(sb.st_mtime, tbuf, sizeof tbuf);
-    printf("%s %3ld %-8s %-8s %9lld %s %s", perms, (long)sb.st_nlink,
-            pw ? pw->pw_name : "unknown", gr ? gr->gr_name : "unknown",
-            (long long)sb.st_size, tbuf, path);
-    if (p->showlink && S_ISLNK(sb.st_mode)) {
+    if (p->showlink && S_ISLNK(m->mode)) {
         char tgt[PATH_MAX];
-        ssize_t n = readlink(path, tgt, sizeof(tgt)-1);
-        if (n >= 0) { tgt[n] = '\0'; printf(" -> %s", tgt); }
+        ssize_t n = readlinkat(dfd, name, tgt, sizeof(tgt)-1);
+        if (n >= 0) {
+            strbuf_append(out, " -> ", 4);
+            strbuf_append(out, tgt, (size_t)n);
+        }
     }
-    putchar('\n');
+    strbuf_putc(out, '\n');
+}
+
+static int print_one_with_params(const char *path, const DirParams *p){
+    tMeta m;
+    if (meta_one(AT_FDCWD, path, dir_meta_need(p->longfmt, DIR_SORT_NONE), &m) == -1) {
+        perror(path);
+        return 1;
+    }
+    tStrBuf line;
+    strbuf_init(&line);
+    format_entry(&line, NULL, path, AT_FDCWD, &m, p);
+    if (line.len) fwrite(line.data, 1, line.len, stdout);
+    strbuf_free(&line);
     return 0;
 }
 
-static int list_dir_once(const char *dirpath, const DirParams *p){
-    DIR *d = opendir(dirpath);
-    if (!d) { perror(dirpath); return 1; }
-    printf("%s:\n", dirpath);
-    int n, status = 0;
-    struct dirent *de;
-    char full[PATH_MAX];
-    while ((de = readdir(d)) != NULL) {
-        if (strcmp(de->d_name, ".") == 0 || strcmp(de->d_name, "..") == 0)
-            continue;
-        if (!p->showhid && is_hidden_name(de->d_name)) continue;
-        n = snprintf(full, sizeof full, "%s/%s", dirpath, de->d_name);
-        if (n < 0 || (size_t)n >= sizeof full) {
-            fprintf(stderr, "Path too long: %s/%s\n", dirpath, de->d_name);
-            status = 1; continue;
+/* Entradas de un directorio: los nombres van seguidos en names_blob y el
+ * resto en un único bloque (arena) que se libera de una vez */
+typedef struct {
+    tStrBuf names_blob;
+    tVector offs;           // desplazamiento de cada nombre en names_blob
+    void *arena;
+    const char **names;
+    tMeta *meta;
+    int *errs;
+    tSortKey *order;        // orden de salida (idx = entrada)
+    size_t count;
+} tDirList;
+
+static void dirlist_free(tDirList *l){
+    strbuf_free(&l->names_blob);
+    vector_free(&l->offs);
+    free(l->arena);
+}
+
+// names[i] = blob + offs[i]; el resto de la arena queda sin rellenar
+static int dirlist_alloc(tDirList *l, const char *blob, const size_t *offs){
+    size_t n = l->count ? l->count : 1;
+    size_t sz_names = n * sizeof *l->names, sz_meta = n * sizeof *l->meta;
+    size_t sz_order = n * sizeof *l->order, sz_errs = n * sizeof *l->errs;
+    // Orden de mayor a menor alineación para no necesitar relleno
+    char *a = malloc(sz_order + sz_meta + sz_names + sz_errs);
+    if (!a) return -1;
+    l->arena = a;
+    l->order = (tSortKey *)a;
+    l->meta = (tMeta *)(a + sz_order);
+    l->names = (const char **)(a + sz_order + sz_meta);
+    l->errs = (int *)(a + sz_order + sz_meta + sz_names);
+    for (size_t i = 0; i < l->count; ++i) l->names[i] = blob + offs[i];
+    return 0;
+}
+
+// Quita las entradas ocultas (las copias de la caché las incluyen)
+static void dirlist_drop_hidden(tDirList *l){
+    size_t k = 0;
+    for (size_t i = 0; i < l->count; ++i) {
+        if (is_hidden_name(l->names[i])) continue;
+        l->names[k] = l->names[i];
+        l->meta[k] = l->meta[i];
+        l->errs[k] = l->errs[i];
+        ++k;
+    }
+    l->count = k;
+}
+
+/* Los metadatos de un subdirectorio (enlaces, tamaño, mtime) cambian con lo
+ * que pasa dentro de él, que la vigilancia del padre no ve: en una copia de
+ * la caché se vuelven a pedir, solo para los directorios y en un lote */
+static void dirlist_refresh_dirs(tDirList *l, int dfd, unsigned need,
+                                 meta_backend_t backend){
+    size_t nd = 0;
+    for (size_t i = 0; i < l->count; ++i)
+        if (!l->errs[i] && S_ISDIR(l->meta[i].mode)) ++nd;
+    if (nd == 0) return;
+    size_t sz_meta = nd * sizeof(tMeta), sz_idx = nd * sizeof(size_t);
+    size_t sz_names = nd * sizeof(char *);
+    char *a = malloc(sz_meta + sz_idx + sz_names + nd * sizeof(int));
+    if (!a) return;     // se queda lo de la copia
+    tMeta *meta = (tMeta *)a;
+    size_t *idx = (size_t *)(a + sz_meta);
+    const char **names = (const char **)(a + sz_meta + sz_idx);
+    int *errs = (int *)(a + sz_meta + sz_idx + sz_names);
+    for (size_t i = 0, k = 0; i < l->count; ++i)
+        if (!l->errs[i] && S_ISDIR(l->meta[i].mode)) {
+            idx[k] = i;
+            names[k++] = l->names[i];
         }
-        if (print_one_with_params(full, p) != 0) status = 1;
+    meta_batch(dfd, names, nd, need, backend, meta, errs);
+    for (size_t k = 0; k < nd; ++k) {
+        l->meta[idx[k]] = meta[k];
+        l->errs[idx[k]] = errs[k];
     }
-    closedir(d);
-    putchar('\n');
-    return status;
+    free(a);
 }
 
-static int list_dir_recursive(const char *dirpath, const DirParams *p) {
-    int status = 0;
-    if (p->rec == DIR_REC_RECA || p->rec == DIR_REC_NOREC) {
-        if (list_dir_once(dirpath, p) != 0) status = 1;
-    }
-    if (p->rec != DIR_REC_NOREC) {
-        DIR *d = opendir(dirpath);
-        if (!d) { perror(dirpath); return 1; }
-        struct dirent *de;
-        char full[PATH_MAX];
-        while ((de = readdir(d)) != NULL) {
-            if (strcmp(de->d_name, ".") == 0 || strcmp(de->d_name, "..") == 0)
-                continue;
-            if (!p->showhid && is_hidden_name(de->d_name)) continue;
-            int n = snprintf(full, sizeof full, "%s/%s", dirpath, de->d_name);
-            if (n < 0 || (size_t)n >= sizeof full) {
-                fprintf(stderr, "Path too long: %s/%s\n", dirpath, de->d_name);
-                status = 1; continue;
-            }
-            struct stat sb;
-            if (lstat(full, &sb) != 0) { perror(full); status = 1; continue; }
-            if (S_ISDIR(sb.st_mode)) {
-                if (list_dir_recursive(full, p) != 0) status = 1;
+// Los 8 primeros bytes del nombre en big-endian: ordenan como strcmp
+static uint64_t name_prefix_key(const char *name){
+    uint64_t k = 0;
+    int i = 0;
+    for (; i < 8 && name[i]; ++i) k = (k << 8) | (unsigned char)name[i];
+    return k << (8 * (8 - i));
+}
+
+typedef struct {
+    const char *name;
+    size_t idx;
+} tNameIdx;
+
+static int cmp_name_idx(const void *a, const void *b){
+    return strcmp(((const tNameIdx *)a)->name, ((const tNameIdx *)b)->name);
+}
+
+/* Por nombre: radix sobre el prefijo y strcmp solo en los tramos que lo
+ * comparten. Por tamaño o fecha (mayores y más recientes primero, como
+ * ls -S/-t): radix estable sobre el orden por nombre, que deshace empates.
+ * Las entradas sin metadatos van al final. */
+static void dirlist_sort(tDirList *l, dir_sort_t sort){
+    size_t n = l->count;
+    tSortKey *o = l->order;
+    for (size_t i = 0; i < n; ++i) o[i].idx = i;
+    if (sort == DIR_SORT_NONE || n < 2) return;
+    for (size_t i = 0; i < n; ++i) o[i].key = name_prefix_key(l->names[i]);
+    if (radix_sort(o, n) != 0) return;
+    for (size_t i = 0, j; i < n; i = j) {
+        for (j = i + 1; j < n && o[j].key == o[i].key; ++j) {}
+        if (j - i < 2) continue;
+        tNameIdx *run = malloc((j - i) * sizeof *run);
+        if (!run) return;
+        for (size_t k = i; k < j; ++k)
+            run[k - i] = (tNameIdx){ l->names[o[k].idx], o[k].idx };
+        qsort(run, j - i, sizeof *run, cmp_name_idx);
+        for (size_t k = i; k < j; ++k) o[k].idx = run[k - i].idx;
+        free(run);
+    }
+    if (sort == DIR_SORT_NAME) return;
+    for (size_t i = 0; i < n; ++i) {
+        const tMeta *m = &l->meta[o[i].idx];
+        uint64_t v = sort == DIR_SORT_SIZE ? (uint64_t)m->size
+                   : (uint64_t)(int64_t)m->mtime ^ (UINT64_C(1) << 63);
+        o[i].key = l->errs[o[i].idx] ? UINT64_MAX : ~v;
+    }
+    (void)radix_sort(o, n);
+}
+
+/* Lista un directorio dentro del recorrido paralelo en tres fases: se
+ * leen todos los nombres, se piden sus metadatos de una vez con
+ * meta_batch() relativos al descriptor del directorio y, tras ordenar si
+ * hace falta, se formatean. Los metadatos sirven también para decidir si
+ * se baja. Con la caché activa, las dos primeras fases se saltan si el
+ * directorio no ha cambiado; lo leído se guarda entero (con las ocultas y
+ * los campos de -long) para servir a cualquier formato. */
+static int dir_scan(tWalk *w, tWalkNode *n, void *ctx){
+    const DirParams *p = ctx;
+    int dfd = walk_open(n);
+    if (dfd == -1) {
+        buf_error(&n->err, n->path, errno);
+        return 1;
+    }
+    tDcTicket tk = { 0 };
+    const tDirSnap *snap = p->cache ? dcache_get(dfd, &tk) : NULL;
+    bool keep_hidden = p->showhid || p->cache;
+    unsigned need = dir_meta_need(p->longfmt || p->cache, p->sort);
+    int status = 0, more, read_err = 0;
+    tDirList l;
+    memset(&l, 0, sizeof l);
+    strbuf_init(&l.names_blob);
+    vector_init(&l.offs, sizeof(size_t));
+    if (snap) {
+        l.count = snap->count;
+        if (dirlist_alloc(&l, snap->names, snap->offs) != 0) {
+            l.count = 0;
+            read_err = ENOMEM;
+        } else {
+            memcpy(l.meta, snap->meta, l.count * sizeof *l.meta);
+            memcpy(l.errs, snap->errs, l.count * sizeof *l.errs);
+        }
+    } else {
+        tDirReader rd;
+        if (dreader_init(&rd, dfd) != 0) {
+            buf_error(&n->err, n->path, errno);
+            vector_free(&l.offs);
+            return 1;
+        }
+        tDirEntry de;
+        while ((more = dreader_next(&rd, &de)) > 0) {
+            if (!keep_hidden && is_hidden_name(de.name)) continue;
+            size_t off = l.names_blob.len;
+            if (strbuf_append(&l.names_blob, de.name, strlen(de.name) + 1) != 0 ||
+                !vector_push(&l.offs, &off)) {
+                more = -1; errno = ENOMEM;
+                break;
             }
         }
-        closedir(d);
+        if (more < 0) read_err = errno;
+        dreader_free(&rd);
+
+        l.count = l.offs.len;
+        const size_t *offs = (const size_t *)l.offs.data;
+        if (dirlist_alloc(&l, l.names_blob.data, offs) != 0) {
+            l.count = 0;
+            read_err = ENOMEM;
+        }
+        meta_batch(dfd, l.names, l.count, need, p->meta, l.meta, l.errs);
+        if (tk.ok && !read_err)
+            dcache_put(&tk, l.names_blob.data, l.names_blob.len, offs,
+                       l.count, l.meta, l.errs);
     }
-    if (p->rec == DIR_REC_RECB) {
-        if (list_dir_once(dirpath, p) != 0) status = 1;
+    if (!p->showhid && keep_hidden) dirlist_drop_hidden(&l);
+    if (snap) dirlist_refresh_dirs(&l, dfd, need, p->meta);
+    strbuf_append(&n->out, n->path, strlen(n->path));
+    strbuf_append(&n->out, ":\n", 2);
+    dirlist_sort(&l, p->sort);
+
+    for (size_t k = 0; k < l.count; ++k) {
+        size_t i = l.order[k].idx;
+        if (l.errs[i] != 0) {
+            char *full = join_path(n->path, l.names[i]);
+            buf_error(&n->err, full ? full : l.names[i], l.errs[i]);
+            free(full);
+            status = 1; continue;
+        }
+        format_entry(&n->out, n->path, l.names[i], dfd, &l.meta[i], p);
+        if (p->rec != DIR_REC_NOREC && S_ISDIR(l.meta[i].mode) &&
+            !walk_add_child(w, n, l.names[i])) {
+            char *full = join_path(n->path, l.names[i]);
+            buf_error(&n->err, full ? full : l.names[i], ENOMEM);
+            free(full);
+            status = 1;
+        }
     }
+    if (read_err) { buf_error(&n->err, n->path, read_err); status = 1; }
+    dirlist_free(&l);
+    dcache_release(snap);
+    strbuf_putc(&n->out, '\n');
     return status;
 }
 
+static int list_dir_recursive(const char *dirpath, const DirParams *p) {
+    tWalkOpts o;
+    o.scan = dir_scan;
+    o.emit = NULL;
+    o.ctx = (void *)p;
+    o.order = (p->rec == DIR_REC_RECB) ? WALK_POSTORDER : WALK_PREORDER;
+    // Sin recursión no compensa arrancar hilos
+    o.threads = (p->rec == DIR_REC_NOREC) ? 1 : p->threads;
+    return walk_run(dirpath, &o);
+}
+
 
 tItemF *make_itemF(int fd, const char *name, int mode) {
     tItemF *p = malloc(sizeof *p);
     if (!p) { perror("malloc"); exit(1); }
     p->fileDescriptor = fd;
-    strncpy(p->filename, name, sizeof(p->filename) - 1);
-    p->filename[sizeof(p->filename) - 1] = '\0';
+    p->filename = strdup(name);
+    if (!p->filename) { perror("strdup"); exit(1); }
     p->mode = mode;
+    p->name_next = NULL;
+    p->wbuf = NULL;
+    p->wlen = p->wcap = 0;
     return p;
 }
 
@@ -178,43 +666,38 @@ static void take_flags(int flags, char *out, size_t n)
 
 int cmd_listOpen(int argc, char *argv[]) {
     (void)argc; (void)argv;
-    if (!open_files || open_files->head == NULL) { printf("Empty list\n"); return 1; }
-    for (Node *n = open_files->head; n; n = n->next) {
-        tItemF *it = (tItemF*)n->data;
+    if (!open_files_ready || open_count == 0) { printf("Empty list\n"); return 1; }
+    for (size_t fd = 0; fd < open_files.len; ++fd) {
+        tItemF *it = lookup_fd((int)fd);
+        if (!it) continue;
         char fl[128];
         take_flags(it->mode, fl, sizeof fl);
+        char bufinfo[64] = "";
+        if (it->wbuf)
+            snprintf(bufinfo, sizeof bufinfo, " buffered=%zu/%zu", it->wlen,
+                     it->wcap);
+        // La posición es la del kernel: no cuenta lo que sigue en el buffer
         off_t pos = lseek(it->fileDescriptor, 0, SEEK_CUR);
         if (pos == (off_t)-1) {
-            printf("[%d] %s (mode=%s) pos=?\n",
-                    it->fileDescriptor, it->filename, fl);
+            printf("[%d] %s (mode=%s) pos=?%s\n",
+                    it->fileDescriptor, it->filename, fl, bufinfo);
         } else {
-            printf("[%d] %s (mode=%s) pos=%jd\n",
-                    it->fileDescriptor, it->filename, fl, (intmax_t)pos);
+            printf("[%d] %s (mode=%s) pos=%jd%s\n",
+                    it->fileDescriptor, it->filename, fl, (intmax_t)pos,
+                    bufinfo);
         }
     }
     return 0;
 }
 
-static int comparar_itemF_fd(void *data, void *key) {
-    const tItemF *it = (const tItemF*)data;
-    const int fd = *(const int*)key;
-    if (it->fileDescriptor == fd) return 0;
-    return (it->fileDescriptor > fd) - (it->fileDescriptor < fd);
-}
-
-static int comparar_itemF_name(void *data, void *key) {
-    const tItemF *it = (const tItemF*)data;
-    const char *name = (const char*)key;
-    if (strcmp(it->filename, name) == 0) return 0;
-    return strcmp(it->filename, name);
-}
-
-int addFile(List *lista, const char *path, int flags)
+int addFile(const char *path, int flags)
 {
+    if (!file_list_ready()) return 1;
     int fd = (flags & O_CREAT) ? open(path, flags, 0666) : open(path, flags);
     if (fd == -1) { perror("open"); return 1; }
     tItemF *it = make_itemF(fd, path, flags);
-    if (insertItem(lista, it) != 0) {
+    if (register_file(it) != 0) {
+        free(it->filename);
         free(it);
         close(fd);
         fprintf(stderr, "Could not insert on the list\n");
@@ -227,13 +710,32 @@ int addFile(List *lista, const char *path, int flags)
 void delFile(void *data) {
     if (!data) return;
     tItemF *it = (tItemF*)data;
+    if (item_flush(it) != 0) perror(it->filename);
     if (it->fileDescriptor > 2) close(it->fileDescriptor);
+    free(it->wbuf);
+    free(it->filename);
     free(it);
 }
 
 static void free_itemF(void *data) {
     if (!data) return;
-    free(data);
+    tItemF *it = (tItemF*)data;
+    unregister_file(it);
+    free(it->wbuf);
+    free(it->filename);
+    free(it);
+}
+
+// buf=N[k|M]: tamaño del buffer de escritura; 0 si no es válido
+static size_t parse_buf_size(const char *arg){
+    char *end;
+    errno = 0;
+    unsigned long long v = strtoull(arg, &end, 10);
+    if (end == arg || errno || *arg == '-') return 0;
+    if (*end == 'k' || *end == 'K') { v <<= 10; ++end; }
+    else if (*end == 'm' || *end == 'M') { v <<= 20; ++end; }
+    if (*end != '\0' || v > OPEN_BUF_MAX) return 0;
+    return (size_t)v;
 }
 
 int cmd_open (int argc, char *argv[])
@@ -241,7 +743,16 @@ int cmd_open (int argc, char *argv[])
     if (!file_list_ready()) return 1;
     if (argc == 1) { return cmd_listOpen(argc, argv); }
     int flags = 0;
+    size_t bufsize = 0;
     for (int i = 2; argv[i] != NULL; ++i) {
+        if (!strncmp(argv[i], "buf=", 4)) {
+            if ((bufsize = parse_buf_size(argv[i] + 4)) == 0) {
+                fprintf(stderr, "open: invalid buffer size '%s' (1..%uM)\n",
+                        argv[i] + 4, OPEN_BUF_MAX >> 20);
+                return 1;
+            }
+            continue;
+        }
         if      (!strcmp(argv[i], "cr")) flags |= O_CREAT;
         else if (!strcmp(argv[i], "ex")) flags |= O_EXCL;
         else if (!strcmp(argv[i], "ro")) flags |= O_RDONLY;
@@ -254,13 +765,27 @@ int cmd_open (int argc, char *argv[])
     int fd = open(argv[1], flags, 0666);
     if (fd == -1) { perror("open"); return 1; }
     tItemF *item = make_itemF(fd, argv[1], flags);
-    if (insertItem(open_files, item) != 0) {
-        perror("insertItem");
+    if (bufsize && !(item->wbuf = malloc(bufsize))) {
+        perror("malloc");
+        close(fd);
+        free(item->filename);
+        free(item);
+        return 1;
+    }
+    item->wcap = bufsize;
+    if (register_file(item) != 0) {
+        perror("register_file");
         close(fd);
+        free(item->wbuf);
+        free(item->filename);
         free(item);
         return 1;
     }
-    printf("Opened [%d] %s (mode=%d)\n", fd, argv[1], flags);
+    if (bufsize)
+        printf("Opened [%d] %s (mode=%d, buf=%zu)\n", fd, argv[1], flags,
+               bufsize);
+    else
+        printf("Opened [%d] %s (mode=%d)\n", fd, argv[1], flags);
     return 0;
 }
 
@@ -273,38 +798,36 @@ int cmd_close (int argc, char *argv[]){
     errno = 0;
     long lfd = strtol(argv[1], &endp, 10);
     tItemF *f = NULL;
-    int df = -1;
-    bool close_by_fd = false;
     if (errno == 0 && endp && *argv[1] != '\0' && *endp == '\0') {
-        close_by_fd = true;
-        df = (int)lfd;
-        if (df < 0) {
+        if (lfd < 0 || lfd > INT_MAX) {
             fprintf(stderr, "close: invalid fd '%s'\n", argv[1]);
             return 1;
         }
-        f = (tItemF*)findItem(open_files, &df, comparar_itemF_fd);
+        int df = (int)lfd;
+        f = lookup_fd(df);
         if (!f) {
             fprintf(stderr, "close: fd %d not found in open list\n", df);
             return 1;
         }
     } else {
-        f = (tItemF*)findItem(open_files, argv[1], comparar_itemF_name);
+        f = lookup_name(argv[1]);
         if (!f) {
             fprintf(stderr, "close: file '%s' not found in open list\n",
                 argv[1]); return 1; }
-        df = f->fileDescriptor;
     }
-    char closed_name[MAX];
     int closed_fd = f->fileDescriptor;
-    strncpy(closed_name, f->filename, sizeof(closed_name) - 1);
-    closed_name[sizeof(closed_name) - 1] = '\0';
+    if (aio_busy_fd(closed_fd)) {
+        fprintf(stderr, "close: fd %d has asynchronous I/O in flight "
+                "(see aio, await)\n", closed_fd);
+        return 1;
+    }
+    int status = 0;
+    if (item_flush(f) != 0) { perror("flush"); status = 1; }
     if (closed_fd > 2)
         if (close(closed_fd) == -1) { perror("close"); return 1; }
-    if (close_by_fd)
-        deleteItem(open_files, &df, comparar_itemF_fd, free_itemF);
-    else { deleteItem(open_files, argv[1], comparar_itemF_name, free_itemF); }
-    printf("Closed [%d] %s\n", closed_fd, closed_name);
-    return 0;
+    printf("Closed [%d] %s\n", closed_fd, f->filename);
+    free_itemF(f);
+    return status;
 }
 
 int cmd_dup(int argc, char *argv[])
@@ -313,17 +836,20 @@ int cmd_dup(int argc, char *argv[])
     if (argc == 1) { fprintf(stderr, "dup: missing fd\n"); return 1; }
     int df = atoi(argv[1]);
     if (df < 0) { fprintf(stderr, "dup: invalid fd '%s'\n", argv[1]); return 1;}
-    tItemF *f = (tItemF*)findItem(open_files, &df, comparar_itemF_fd);
+    tItemF *f = lookup_fd(df);
     if (!f) {
         fprintf(stderr, "dup: fd %d not found in open list\n", df);
         return 1;
     }
+    // El duplicado comparte posición: lo pendiente tiene que ir antes
+    if (item_flush(f) != 0) { perror("flush"); return 1; }
     int duplicated = dup(df);
     if (duplicated == -1) { perror("dup"); return 1; }
     tItemF *newItem = make_itemF(duplicated, f->filename, f->mode);
-    if (insertItem(open_files, newItem) != 0) {
-        perror("insertItem");
+    if (register_file(newItem) != 0) {
+        perror("register_file");
         close(duplicated);
+        free(newItem->filename);
         free(newItem);
         return 1;
     }
@@ -331,76 +857,51 @@ int cmd_dup(int argc, char *argv[])
     return 0;
 }
 
+/* Permisos por tablas, sin una rama por bit: las tres ternas rwx se
+ * copian de rwx_table y la letra de tipo sale de los bits de formato
+ * (0170000) desplazados. Solo setuid, setgid y sticky van aparte. */
+static const char rwx_table[8][4] = {
+    "---", "--x", "-w-", "-wx", "r--", "r-x", "rw-", "rwx"
+};
+
+static const char type_table[16] = {
+    '?', 'p', 'c', '?', 'd', '?', 'b', '?',     // pipe, char, dir, block
+    '-', '?', 'l', '?', 's', '?', '?', '?'      // normal, enlace, socket
+};
+
 static char assignLetterToType(const mode_t mode){
-    switch (mode & __S_IFMT)
-    { // AND bit a bit con los bits de formato 0170000
-    case __S_IFSOCK: return 's'; // socket
-    case __S_IFLNK: return 'l'; // symbolic link
-    case __S_IFREG: return '-'; // fichero normal
-    case __S_IFBLK: return 'b'; // block device
-    case __S_IFDIR: return 'd'; // directorio
-    case __S_IFCHR: return 'c'; // char device
-    case __S_IFIFO: return 'p'; // pipe
-    default: return '?'; // desconocido
+    return type_table[(mode & S_IFMT) >> 12];
+}
+
+static char *fill_mode(mode_t m, char *permisos){
+    permisos[0] = assignLetterToType(m);
+    memcpy(permisos + 1, rwx_table[(m >> 6) & 7], 3);  /*propietario*/
+    memcpy(permisos + 4, rwx_table[(m >> 3) & 7], 3);  /*grupo*/
+    memcpy(permisos + 7, rwx_table[m & 7], 3);         /*resto*/
+    if (m & (S_ISUID | S_ISGID | __S_ISVTX)) {   /*setuid, setgid y stickybit*/
+        if (m&S_ISUID) permisos[3]='s';
+        if (m&S_ISGID) permisos[6]='s';
+        if (m&__S_ISVTX) permisos[9]='t';
     }
+    permisos[10] = ' ';
+    permisos[11] = '\0';
+    return permisos;
 }
 
 char * convertMode (mode_t m, char *permisos){
-    strcpy (permisos,"---------- ");
-    permisos[0]=assignLetterToType(m);
-    if (m&S_IRUSR) permisos[1]='r';    /*propietario*/
-    if (m&S_IWUSR) permisos[2]='w';
-    if (m&S_IXUSR) permisos[3]='x';
-    if (m&S_IRGRP) permisos[4]='r';    /*grupo*/
-    if (m&S_IWGRP) permisos[5]='w';
-    if (m&S_IXGRP) permisos[6]='x';
-    if (m&S_IROTH) permisos[7]='r';    /*resto*/
-    if (m&S_IWOTH) permisos[8]='w';
-    if (m&S_IXOTH) permisos[9]='x';
-    if (m&S_ISUID) permisos[3]='s';    /*setuid, setgid y stickybit*/
-    if (m&S_ISGID) permisos[6]='s';
-    if (m&__S_ISVTX) permisos[9]='t';
-    return permisos;
+    return fill_mode(m, permisos);
 }
 
 char * convertMode2 (mode_t m){
     static char permisos[12];
-    strcpy (permisos,"---------- ");
-    permisos[0]=assignLetterToType(m);
-    if (m&S_IRUSR) permisos[1]='r';    /*propietario*/
-    if (m&S_IWUSR) permisos[2]='w';
-    if (m&S_IXUSR) permisos[3]='x';
-    if (m&S_IRGRP) permisos[4]='r';    /*grupo*/
-    if (m&S_IWGRP) permisos[5]='w';
-    if (m&S_IXGRP) permisos[6]='x';
-    if (m&S_IROTH) permisos[7]='r';    /*resto*/
-    if (m&S_IWOTH) permisos[8]='w';
-    if (m&S_IXOTH) permisos[9]='x';
-    if (m&S_ISUID) permisos[3]='s';    /*setuid, setgid y stickybit*/
-    if (m&S_ISGID) permisos[6]='s';
-    if (m&__S_ISVTX) permisos[9]='t';
-    return permisos;
+    return fill_mode(m, permisos);
 }
 
 char * convertMode3 (mode_t m){
     char *permisos;
     if ((permisos=(char *) malloc (12))==NULL)
         return NULL;
-    strcpy (permisos,"---------- ");
-    permisos[0]=assignLetterToType(m);
-    if (m&S_IRUSR) permisos[1]='r';    /*propietario*/
-    if (m&S_IWUSR) permisos[2]='w';
-    if (m&S_IXUSR) permisos[3]='x';
-    if (m&S_IRGRP) permisos[4]='r';    /*grupo*/
-    if (m&S_IWGRP) permisos[5]='w';
-    if (m&S_IXGRP) permisos[6]='x';
-    if (m&S_IROTH) permisos[7]='r';    /*resto*/
-    if (m&S_IWOTH) permisos[8]='w';
-    if (m&S_IXOTH) permisos[9]='x';
-    if (m&S_ISUID) permisos[3]='s';    /*setuid, setgid y stickybit*/
-    if (m&S_ISGID) permisos[6]='s';
-    if (m&__S_ISVTX) permisos[9]='t';
-    return permisos;
+    return fill_mode(m, permisos);
 }
 
 int cmd_create(int argc, char *argv[]){
@@ -449,11 +950,16 @@ int cmd_erase(int argc, char *argv[]){
     }else{ perror("Invalid arguments for erase"); return 1; }
 }
 
+// Indexado por dir_sort_t
+static const char *const sort_names[] = { "none", "name", "size", "mtime",
+                                          NULL };
+
 int cmd_setdirparams(int argc, char *argv[]){
     if (argc < 2) {
         fprintf(stderr,
             "Usage: setdirparams long|short | link|nolink | hid|nohid | "
-            "reca|recb|norec\n");
+            "reca|recb|norec | threads=N | meta=auto|uring|threads|sync | "
+            "sort=none|name|size|mtime | cache|nocache\n");
         return 1;
     }
     for (int i = 1; i < argc; ++i) {
@@ -467,6 +973,38 @@ int cmd_setdirparams(int argc, char *argv[]){
         else if (strcmp(a,"reca")  == 0) global_dir_params.rec = DIR_REC_RECA;
         else if (strcmp(a,"recb")  == 0) global_dir_params.rec = DIR_REC_RECB;
         else if (strcmp(a,"norec") == 0) global_dir_params.rec = DIR_REC_NOREC;
+        else if (strcmp(a,"cache") == 0) global_dir_params.cache = true;
+        else if (strcmp(a,"nocache") == 0) {
+            global_dir_params.cache = false;
+            dcache_clear();
+        }
+        else if (strncmp(a,"threads=", 8) == 0) {
+            char *end;
+            long t = strtol(a + 8, &end, 10);
+            if (a[8] == '\0' || *end != '\0' || t < 0 || t > HILOS_MAX) {
+                fprintf(stderr, "setdirparams: threads must be 0..%d\n",
+                        HILOS_MAX);
+                return 1;
+            }
+            global_dir_params.threads = (int)t;
+        }
+        else if (strncmp(a,"meta=", 5) == 0) {
+            if (meta_backend_parse(a + 5, &global_dir_params.meta) != 0) {
+                fprintf(stderr, "setdirparams: meta must be "
+                        "auto|uring|threads|sync\n");
+                return 1;
+            }
+        }
+        else if (strncmp(a,"sort=", 5) == 0) {
+            int k = 0;
+            while (sort_names[k] && strcmp(a + 5, sort_names[k]) != 0) ++k;
+            if (!sort_names[k]) {
+                fprintf(stderr, "setdirparams: sort must be "
+                        "none|name|size|mtime\n");
+                return 1;
+            }
+            global_dir_params.sort = (dir_sort_t)k;
+        }
         else {
             fprintf(stderr, "setdirparams: invalid parameter '%s'\n", a);
             return 1;
@@ -483,6 +1021,18 @@ int cmd_getdirparams(int argc, char *argv[]){
     const char *r = (global_dir_params.rec == DIR_REC_NOREC) ? "norec" :
                     (global_dir_params.rec == DIR_REC_RECA)  ? "reca"  : "recb";
     printf("recursion: %s\n", r);
+    if (global_dir_params.threads == 0)
+        printf("threads  : auto (%d)\n", hilos_online());
+    else printf("threads  : %d\n", global_dir_params.threads);
+    printf("metadata : %s\n", meta_backend_name(global_dir_params.meta));
+    printf("sort     : %s\n", sort_names[global_dir_params.sort]);
+    if (global_dir_params.cache) {
+        size_t dirs, entries;
+        bool watched;
+        dcache_info(&dirs, &entries, &watched);
+        printf("cache    : on (%zu dirs, %zu entries, %s)\n", dirs, entries,
+               watched ? "inotify" : "mtime check");
+    } else printf("cache    : off\n");
     return 0;
 }
 
@@ -508,41 +1058,928 @@ int cmd_dir(int argc, char *argv[]){
     return status;
 }
 
-static int delrec_path(const char *path){
+/* find sobre el recorrido paralelo. Cada directorio se evalúa a sí mismo
+ * (con fstat sobre su descriptor) y escribe su ruta antes que sus
+ * entradas, así que la salida va en preorden. En el padre, los predicados
+ * de nombre y tipo se resuelven con d_type antes de consultar nada; solo
+ * las entradas que siguen en pie y necesitan tamaño o fecha (o cuyo tipo
+ * no da el FS) pasan por meta_batch(). Lo que supera -maxdepth ni se abre. */
+typedef enum { CMP_NONE, CMP_LT, CMP_EQ, CMP_GT } find_cmp_t;
+
+typedef struct {
+    const char *glob;           // -name (NULL: cualquiera)
+    char type;                  // -type f|d|l (0: cualquiera)
+    find_cmp_t size_cmp;
+    unsigned long long size;    // en unidades de size_unit
+    unsigned long long size_unit;
+    find_cmp_t mtime_cmp;
+    long long mtime_days;
+    int maxdepth;               // -1: sin límite
+    bool showhid;
+    time_t now;
+} tFindSpec;
+
+static bool find_need_meta(const tFindSpec *f){
+    return f->size_cmp != CMP_NONE || f->mtime_cmp != CMP_NONE;
+}
+
+static bool find_cmp(find_cmp_t c, long long v, long long ref){
+    switch (c) {
+    case CMP_LT: return v < ref;
+    case CMP_EQ: return v == ref;
+    case CMP_GT: return v > ref;
+    default: return true;
+    }
+}
+
+// Predicados que no necesitan metadatos; type ENT_UNKNOWN siempre pasa
+static bool find_match_cheap(const tFindSpec *f, const char *name,
+                             ent_type_t type){
+    if (f->glob && fnmatch(f->glob, name, 0) != 0) return false;
+    if (!f->type || type == ENT_UNKNOWN) return true;
+    ent_type_t want = f->type == 'f' ? ENT_REG : f->type == 'd' ? ENT_DIR
+                                                                : ENT_LNK;
+    return type == want;
+}
+
+static ent_type_t type_of_mode(mode_t m){
+    return S_ISREG(m) ? ENT_REG : S_ISDIR(m) ? ENT_DIR
+         : S_ISLNK(m) ? ENT_LNK : ENT_OTHER;
+}
+
+static bool find_match_meta(const tFindSpec *f, const char *name,
+                            const tMeta *m){
+    if (!find_match_cheap(f, name, type_of_mode(m->mode))) return false;
+    if (f->size_cmp != CMP_NONE) {
+        // Como find: el tamaño se redondea hacia arriba a la unidad
+        unsigned long long sz = (unsigned long long)m->size;
+        long long units = (long long)((sz + f->size_unit - 1) / f->size_unit);
+        if (!find_cmp(f->size_cmp, units, (long long)f->size)) return false;
+    }
+    if (f->mtime_cmp != CMP_NONE) {
+        long long age = ((long long)f->now - (long long)m->mtime) / 86400;
+        if (!find_cmp(f->mtime_cmp, age, f->mtime_days)) return false;
+    }
+    return true;
+}
+
+static const char *base_name(const char *path){
+    const char *slash = strrchr(path, '/');
+    return slash && slash[1] ? slash + 1 : path;
+}
+
+static void find_emit(tStrBuf *out, const char *dir, const char *name){
+    if (dir) {
+        strbuf_append(out, dir, strlen(dir));
+        strbuf_putc(out, '/');
+    }
+    strbuf_append(out, name, strlen(name));
+    strbuf_putc(out, '\n');
+}
+
+// Entrada del directorio pendiente de decidir: nombre y tipo según d_type
+typedef struct {
+    size_t off;
+    ent_type_t type;
+    bool need_meta;
+} tFindCand;
+
+static int find_scan(tWalk *w, tWalkNode *n, void *ctx){
+    const tFindSpec *f = ctx;
+    int dfd = walk_open(n);
+    int status = 0;
+    tMeta m;
     struct stat sb;
-    int n;
-    if (lstat(path, &sb) == -1) { perror(path); return 1; }
-    if (!S_ISDIR(sb.st_mode)) {
-        if (unlink(path) == -1) { perror(path); return 1; }
-        return 0;
+    bool have = false;
+    if (dfd != -1 && fstat(dfd, &sb) == 0) {
+        m.size = sb.st_size; m.mtime = sb.st_mtime; m.mode = sb.st_mode;
+        have = true;
+    } else if (meta_one(AT_FDCWD, n->path, META_SIZE | META_MTIME, &m) == 0) {
+        have = true;
     }
-    DIR *d = opendir(path);
-    if (!d) { perror(path); return 1; }
-    int status = 0; struct dirent *de; char full[PATH_MAX];
-    while ((de = readdir(d)) != NULL) {
-        if (strcmp(de->d_name, ".") == 0 || strcmp(de->d_name, "..") == 0)
+    if (have && find_match_meta(f, n->name, &m))
+        find_emit(&n->out, NULL, n->path);
+    if (dfd == -1) {
+        buf_error(&n->err, n->path, errno);
+        return 1;
+    }
+    if (f->maxdepth >= 0 && n->depth >= f->maxdepth) return 0;
+
+    tDirReader rd;
+    if (dreader_init(&rd, dfd) != 0) {
+        buf_error(&n->err, n->path, errno);
+        return 1;
+    }
+    tStrBuf blob;
+    tVector cands;
+    strbuf_init(&blob);
+    vector_init(&cands, sizeof(tFindCand));
+    bool descend = f->maxdepth < 0 || n->depth + 1 < f->maxdepth;
+    size_t nmeta = 0;
+    tDirEntry de;
+    int more;
+    while ((more = dreader_next(&rd, &de)) > 0) {
+        if (!f->showhid && is_hidden_name(de.name)) continue;
+        tFindCand c = { blob.len, de.type, false };
+        if (de.type == ENT_DIR) {
+            // Se evaluará a sí mismo como nodo; basta con bajar
+        } else if (!find_match_cheap(f, de.name, de.type)) {
+            // Descartado sin stat, salvo que pueda ser un directorio
+            if (de.type != ENT_UNKNOWN) continue;
+            c.need_meta = true;
+        } else {
+            c.need_meta = de.type == ENT_UNKNOWN || find_need_meta(f);
+        }
+        if (strbuf_append(&blob, de.name, strlen(de.name) + 1) != 0 ||
+            !vector_push(&cands, &c)) {
+            more = -1; errno = ENOMEM;
+            break;
+        }
+        if (c.need_meta) ++nmeta;
+    }
+    if (more < 0) { buf_error(&n->err, n->path, errno); status = 1; }
+    dreader_free(&rd);
+
+    // Metadatos por lotes solo de las entradas que los necesitan
+    const char **names = malloc((nmeta ? nmeta : 1) * sizeof *names);
+    tMeta *meta = malloc((nmeta ? nmeta : 1) * sizeof *meta);
+    int *errs = malloc((nmeta ? nmeta : 1) * sizeof *errs);
+    if (!names || !meta || !errs) {
+        buf_error(&n->err, n->path, ENOMEM);
+        status = 1;
+        cands.len = 0;
+    }
+    size_t k = 0;
+    for (size_t i = 0; i < cands.len; ++i) {
+        tFindCand *c = vector_at(&cands, i);
+        if (c->need_meta) names[k++] = blob.data + c->off;
+    }
+    meta_batch(dfd, names, k, META_SIZE | META_MTIME, dirparams_get()->meta,
+               meta, errs);
+
+    k = 0;
+    for (size_t i = 0; i < cands.len; ++i) {
+        tFindCand *c = vector_at(&cands, i);
+        const char *name = blob.data + c->off;
+        bool is_dir = c->type == ENT_DIR, match = !c->need_meta;
+        if (c->need_meta) {
+            if (errs[k] != 0) {
+                char *full = join_path(n->path, name);
+                buf_error(&n->err, full ? full : name, errs[k]);
+                free(full);
+                status = 1; ++k;
+                continue;
+            }
+            is_dir = S_ISDIR(meta[k].mode);
+            match = !is_dir && find_match_meta(f, name, &meta[k]);
+            ++k;
+        }
+        if (is_dir) {
+            if (descend) {
+                if (!walk_add_child(w, n, name)) {
+                    buf_error(&n->err, n->path, ENOMEM);
+                    status = 1;
+                }
+            } else if (find_match_cheap(f, name, ENT_DIR) &&
+                       (!find_need_meta(f) ||
+                        (meta_one(dfd, name, META_SIZE | META_MTIME, &m) == 0 &&
+                         find_match_meta(f, name, &m)))) {
+                // En el último nivel el directorio no se abre
+                find_emit(&n->out, n->path, name);
+            }
+        } else if (match) {
+            find_emit(&n->out, n->path, name);
+        }
+    }
+    free(names);
+    free(meta);
+    free(errs);
+    vector_free(&cands);
+    strbuf_free(&blob);
+    return status;
+}
+
+static int find_parse_num(const char *arg, const char *opt, find_cmp_t *cmp,
+                          long long *val, unsigned long long *unit){
+    const char *s = arg;
+    *cmp = CMP_EQ;
+    if (*s == '+') { *cmp = CMP_GT; ++s; }
+    else if (*s == '-') { *cmp = CMP_LT; ++s; }
+    char *end;
+    errno = 0;
+    long long v = strtoll(s, &end, 10);
+    if (end == s || errno || v < 0) goto bad;
+    if (unit) {
+        *unit = 1;
+        switch (*end) {
+        case 'c': ++end; break;
+        case 'k': *unit = 1024ull; ++end; break;
+        case 'M': *unit = 1024ull * 1024; ++end; break;
+        case 'G': *unit = 1024ull * 1024 * 1024; ++end; break;
+        default: break;
+        }
+    }
+    if (*end != '\0') goto bad;
+    *val = v;
+    return 0;
+bad:
+    fprintf(stderr, "find: invalid argument '%s' to %s\n", arg, opt);
+    return 1;
+}
+
+/* find [path ...] [-name glob] [-type f|d|l] [-size [+-]N[ckMG]]
+ *      [-mtime [+-]N] [-maxdepth N] */
+int cmd_find(int argc, char *argv[]){
+    const DirParams *p = dirparams_get();
+    tFindSpec f = { NULL, 0, CMP_NONE, 0, 1, CMP_NONE, 0, -1, p->showhid,
+                    time(NULL) };
+    int first_opt = 1;
+    while (first_opt < argc && argv[first_opt][0] != '-') ++first_opt;
+    for (int i = first_opt; i < argc; i += 2) {
+        const char *opt = argv[i], *arg = i + 1 < argc ? argv[i + 1] : NULL;
+        if (!arg) {
+            fprintf(stderr, "find: missing argument to %s\n", opt);
+            return 1;
+        }
+        long long v;
+        if (strcmp(opt, "-name") == 0) f.glob = arg;
+        else if (strcmp(opt, "-type") == 0) {
+            if (strcmp(arg, "f") != 0 && strcmp(arg, "d") != 0 &&
+                strcmp(arg, "l") != 0) {
+                fprintf(stderr, "find: -type must be f, d or l\n");
+                return 1;
+            }
+            f.type = arg[0];
+        } else if (strcmp(opt, "-size") == 0) {
+            if (find_parse_num(arg, opt, &f.size_cmp, &v, &f.size_unit)) return 1;
+            f.size = (unsigned long long)v;
+        } else if (strcmp(opt, "-mtime") == 0) {
+            if (find_parse_num(arg, opt, &f.mtime_cmp, &f.mtime_days, NULL))
+                return 1;
+        } else if (strcmp(opt, "-maxdepth") == 0) {
+            find_cmp_t c;
+            if (find_parse_num(arg, opt, &c, &v, NULL) || c != CMP_EQ ||
+                v > INT_MAX) {
+                if (c != CMP_EQ) fprintf(stderr, "find: -maxdepth needs N >= 0\n");
+                return 1;
+            }
+            f.maxdepth = (int)v;
+        } else {
+            fprintf(stderr, "find: unknown predicate '%s'\n", opt);
+            return 1;
+        }
+    }
+    tWalkOpts o;
+    o.scan = find_scan;
+    o.emit = NULL;
+    o.ctx = &f;
+    o.order = WALK_PREORDER;
+    o.threads = p->threads;
+    int status = 0;
+    char *dot[] = { "." };
+    char **paths = first_opt > 1 ? argv + 1 : dot;
+    int npaths = first_opt > 1 ? first_opt - 1 : 1;
+    for (int i = 0; i < npaths; ++i) {
+        tMeta m;
+        if (meta_one(AT_FDCWD, paths[i], META_SIZE | META_MTIME, &m) != 0) {
+            perror(paths[i]);
+            status = 1;
             continue;
-        n = snprintf(full, sizeof full, "%s/%s", path, de->d_name);
-        if (n < 0 || (size_t)n >= sizeof full) {
-            fprintf(stderr, "Path too long: %s/%s\n", path, de->d_name);
-            status = 1; continue;
         }
-        if (delrec_path(full) != 0) status = 1;
+        if (S_ISDIR(m.mode)) {
+            if (walk_run(paths[i], &o) != 0) status = 1;
+        } else if (find_match_meta(&f, base_name(paths[i]), &m)) {
+            printf("%s\n", paths[i]);
+        }
     }
-    closedir(d);
-    if (rmdir(path) == -1) { perror(path); status = 1; }
     return status;
 }
 
+/* du sobre el recorrido paralelo, en postorden. Cada directorio suma sus
+ * propios bloques (fstat sobre su descriptor) y los de sus entradas que no
+ * son directorios, consultados con meta_batch(); los subdirectorios son
+ * nodos hijos. El total se completa en el hilo emisor: cuando se emite un
+ * nodo sus hijos ya se emitieron y le sumaron lo suyo, y él se lo suma a
+ * su padre. Los ficheros con varios enlaces se cuentan una vez por
+ * (dispositivo, inodo). Los mayores subdirectorios se guardan en un
+ * montículo de mínimos de tamaño K. */
+typedef struct {
+    dev_t dev;
+    ino_t ino;
+} tDuKey;
+
+typedef struct {
+    unsigned long long blocks;  // de 512 bytes
+    unsigned long long bytes;
+} tDuSum;
+
+typedef struct {
+    unsigned long long value;
+    char *path;
+} tDuTop;
+
+typedef struct {
+    int maxdepth;               // -1: todos los directorios; -s es 0
+    bool bytes;                 // -b: tamaño aparente en vez de bloques
+    bool showhid;
+    size_t topk;
+    pthread_mutex_t lock;       // protege seen
+    tHashMap seen;              // tDuKey* de inodos con varios enlaces
+    tVector top;                // tDuTop, montículo de mínimos por value
+} tDuJob;
+
+static uint64_t hash_du_key(const void *k){
+    const tDuKey *d = k;
+    uint64_t x = (uint64_t)d->ino * 0x9e3779b97f4a7c15ull ^ (uint64_t)d->dev;
+    x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ull;
+    x = (x ^ (x >> 27)) * 0x94d049bb133111ebull;
+    return x ^ (x >> 31);
+}
+
+static bool eq_du_key(const void *a, const void *b){
+    const tDuKey *x = a, *y = b;
+    return x->dev == y->dev && x->ino == y->ino;
+}
+
+// false si el inodo ya se contó por otro enlace
+static bool du_first_link(tDuJob *j, const tMeta *m){
+    if (S_ISDIR(m->mode) || m->nlink <= 1) return true;
+    tDuKey key = { m->dev, m->ino };
+    bool first = true;
+    pthread_mutex_lock(&j->lock);
+    if (hashmap_contains(&j->seen, &key)) {
+        first = false;
+    } else {
+        // Sin memoria se cuenta: como mucho, de más
+        tDuKey *k = malloc(sizeof *k);
+        if (k) {
+            *k = key;
+            if (hashmap_put(&j->seen, k, k) != 0) free(k);
+        }
+    }
+    pthread_mutex_unlock(&j->lock);
+    return first;
+}
+
+static void du_add(tDuSum *s, const tMeta *m){
+    s->blocks += (unsigned long long)m->blocks;
+    s->bytes += (unsigned long long)m->size;
+}
+
+static unsigned long long du_value(const tDuJob *j, const tDuSum *s){
+    // Como du -k: KiB ocupados, redondeando hacia arriba
+    return j->bytes ? s->bytes : (s->blocks + 1) / 2;
+}
+
+static void du_line(tStrBuf *out, unsigned long long v, const char *path){
+    strbuf_num(out, (long long)v, 0);
+    strbuf_putc(out, '\t');
+    strbuf_append(out, path, strlen(path));
+    strbuf_putc(out, '\n');
+}
+
+static void du_heap_swap(tDuTop *a, tDuTop *b){
+    tDuTop t = *a;
+    *a = *b;
+    *b = t;
+}
+
+static void du_heap_down(tDuTop *h, size_t n, size_t i){
+    for (;;) {
+        size_t l = 2 * i + 1, r = l + 1, m = i;
+        if (l < n && h[l].value < h[m].value) m = l;
+        if (r < n && h[r].value < h[m].value) m = r;
+        if (m == i) return;
+        du_heap_swap(&h[i], &h[m]);
+        i = m;
+    }
+}
+
+// Solo se copia la ruta si entra entre los K mayores
+static void du_heap_offer(tDuJob *j, unsigned long long v, const char *path){
+    tDuTop *h = (tDuTop *)j->top.data;
+    if (j->top.len == j->topk && v <= h[0].value) return;
+    char *copy = strdup(path);
+    if (!copy) return;
+    if (j->top.len < j->topk) {
+        tDuTop t = { v, copy };
+        if (!vector_push(&j->top, &t)) { free(copy); return; }
+        h = (tDuTop *)j->top.data;
+        for (size_t i = j->top.len - 1; i > 0;) {
+            size_t up = (i - 1) / 2;
+            if (h[up].value <= h[i].value) break;
+            du_heap_swap(&h[up], &h[i]);
+            i = up;
+        }
+    } else {
+        free(h[0].path);
+        h[0].value = v;
+        h[0].path = copy;
+        du_heap_down(h, j->top.len, 0);
+    }
+}
+
+static int du_scan(tWalk *w, tWalkNode *n, void *ctx){
+    tDuJob *j = ctx;
+    tDuSum *sum = calloc(1, sizeof *sum);
+    if (!sum) {
+        buf_error(&n->err, n->path, ENOMEM);
+        return 1;
+    }
+    n->data = sum;
+    int dfd = walk_open(n);
+    struct stat sb;
+    if (dfd == -1 || fstat(dfd, &sb) != 0) {
+        buf_error(&n->err, n->path, errno);
+        return 1;
+    }
+    sum->blocks = (unsigned long long)sb.st_blocks;
+    sum->bytes = (unsigned long long)sb.st_size;
+
+    tDirReader rd;
+    if (dreader_init(&rd, dfd) != 0) {
+        buf_error(&n->err, n->path, errno);
+        return 1;
+    }
+    int status = 0;
+    tStrBuf blob;
+    tVector offs;
+    strbuf_init(&blob);
+    vector_init(&offs, sizeof(size_t));
+    tDirEntry de;
+    int more;
+    while ((more = dreader_next(&rd, &de)) > 0) {
+        if (!j->showhid && is_hidden_name(de.name)) continue;
+        if (de.type == ENT_DIR) {
+            if (!walk_add_child(w, n, de.name)) {
+                more = -1; errno = ENOMEM;
+                break;
+            }
+            continue;
+        }
+        size_t off = blob.len;
+        if (strbuf_append(&blob, de.name, strlen(de.name) + 1) != 0 ||
+            !vector_push(&offs, &off)) {
+            more = -1; errno = ENOMEM;
+            break;
+        }
+    }
+    if (more < 0) { buf_error(&n->err, n->path, errno); status = 1; }
+    dreader_free(&rd);
+
+    size_t cnt = offs.len;
+    const char **names = malloc((cnt ? cnt : 1) * sizeof *names);
+    tMeta *meta = malloc((cnt ? cnt : 1) * sizeof *meta);
+    int *errs = malloc((cnt ? cnt : 1) * sizeof *errs);
+    if (!names || !meta || !errs) {
+        buf_error(&n->err, n->path, ENOMEM);
+        status = 1;
+        cnt = 0;
+    }
+    for (size_t i = 0; i < cnt; ++i)
+        names[i] = blob.data + *(size_t *)vector_at(&offs, i);
+    meta_batch(dfd, names, cnt,
+               META_SIZE | META_BLOCKS | META_NLINK | META_INO,
+               dirparams_get()->meta, meta, errs);
+    for (size_t i = 0; i < cnt; ++i) {
+        if (errs[i] != 0) {
+            char *full = join_path(n->path, names[i]);
+            buf_error(&n->err, full ? full : names[i], errs[i]);
+            free(full);
+            status = 1;
+        } else if (S_ISDIR(meta[i].mode)) {
+            // d_type desconocido: resultó ser un directorio
+            if (!walk_add_child(w, n, names[i])) {
+                buf_error(&n->err, n->path, ENOMEM);
+                status = 1;
+            }
+        } else if (du_first_link(j, &meta[i])) {
+            du_add(sum, &meta[i]);
+        }
+    }
+    free(names);
+    free(meta);
+    free(errs);
+    vector_free(&offs);
+    strbuf_free(&blob);
+    return status;
+}
+
+// En el hilo emisor: los hijos de n ya le sumaron sus totales
+static void du_emit(tWalkNode *n, void *ctx){
+    tDuJob *j = ctx;
+    const tDuSum *sum = n->data;
+    if (!sum) return;
+    if (n->parent && n->parent->data) {
+        tDuSum *up = n->parent->data;
+        up->blocks += sum->blocks;
+        up->bytes += sum->bytes;
+    }
+    unsigned long long v = du_value(j, sum);
+    if (j->maxdepth < 0 || n->depth <= j->maxdepth)
+        du_line(&n->out, v, n->path);
+    if (n->depth > 0 && j->topk) du_heap_offer(j, v, n->path);
+}
+
+static int cmp_du_top(const void *a, const void *b){
+    const tDuTop *x = a, *y = b;
+    if (x->value != y->value) return x->value < y->value ? 1 : -1;
+    return strcmp(x->path, y->path);
+}
+
+/* du [-s] [-b] [-d depth] [-t K] path...: -s solo el total, -d hasta esa
+ * profundidad, -b bytes aparentes en vez de KiB y -t los K mayores
+ * subdirectorios */
+int cmd_du(int argc, char *argv[]){
+    const DirParams *p = dirparams_get();
+    tDuJob j;
+    memset(&j, 0, sizeof j);
+    j.maxdepth = -1;
+    j.showhid = p->showhid;
+    int i = 1;
+    for (; i < argc && argv[i][0] == '-' && argv[i][1] != '\0'; ++i) {
+        const char *opt = argv[i];
+        if (strcmp(opt, "-s") == 0) { j.maxdepth = 0; continue; }
+        if (strcmp(opt, "-b") == 0) { j.bytes = true; continue; }
+        if (strcmp(opt, "-d") != 0 && strcmp(opt, "-t") != 0) {
+            fprintf(stderr, "du: unknown option '%s'\n", opt);
+            return 1;
+        }
+        char *end;
+        long v = i + 1 < argc ? strtol(argv[i + 1], &end, 10) : -1;
+        if (v < 0 || v > INT_MAX || *argv[i + 1] == '\0' || *end != '\0') {
+            fprintf(stderr, "du: %s needs N >= 0\n", opt);
+            return 1;
+        }
+        if (opt[1] == 'd') j.maxdepth = (int)v;
+        else j.topk = (size_t)v;
+        ++i;
+    }
+    if (i >= argc) {
+        fprintf(stderr, "Usage: du [-s] [-b] [-d depth] [-t K] path ...\n");
+        return 1;
+    }
+    pthread_mutex_init(&j.lock, NULL);
+    hashmap_init(&j.seen, hash_du_key, eq_du_key);
+    vector_init(&j.top, sizeof(tDuTop));
+    tWalkOpts o;
+    o.scan = du_scan;
+    o.emit = du_emit;
+    o.ctx = &j;
+    o.order = WALK_POSTORDER;
+    o.threads = p->threads;
+    int status = 0;
+    for (; i < argc; ++i) {
+        tMeta m;
+        if (meta_one(AT_FDCWD, argv[i],
+                     META_SIZE | META_BLOCKS | META_NLINK | META_INO, &m) != 0) {
+            perror(argv[i]);
+            status = 1;
+        } else if (S_ISDIR(m.mode)) {
+            if (walk_run(argv[i], &o) != 0) status = 1;
+        } else if (du_first_link(&j, &m)) {
+            tDuSum s = { 0, 0 };
+            du_add(&s, &m);
+            printf("%llu\t%s\n", du_value(&j, &s), argv[i]);
+        }
+    }
+    if (j.top.len) {
+        qsort(j.top.data, j.top.len, sizeof(tDuTop), cmp_du_top);
+        printf("largest %zu directories:\n", j.top.len);
+        for (size_t k = 0; k < j.top.len; ++k) {
+            tDuTop *t = vector_at(&j.top, k);
+            printf("%llu\t%s\n", t->value, t->path);
+            free(t->path);
+        }
+    }
+    vector_free(&j.top);
+    size_t it = 0;
+    for (tHashSlot *s; (s = hashmap_next(&j.seen, &it));) free(s->value);
+    hashmap_free(&j.seen);
+    pthread_mutex_destroy(&j.lock);
+    return status;
+}
+
+/* Borrado recursivo sobre descriptores. Cada directorio es un nodo que se
+ * abre una vez con openat() respecto a su padre; sus entradas se borran
+ * con unlinkat() sin reconstruir rutas y sus subdirectorios pasan a ser
+ * nodos nuevos. pending cuenta los subdirectorios sin terminar más la
+ * propia lectura: el último en terminar borra el directorio (de abajo
+ * arriba) y avisa al padre. Con -j N los nodos se reparten entre N hilos;
+ * si no, se procesan en el hilo actual. El tipo sale de d_type; solo se
+ * consultan metadatos si el FS no lo da o hay que contar bytes. */
+typedef struct tDelNode {
+    struct tDelNode *parent;
+    int fd;                 // abierto mientras queden hijos por borrar
+    char *path;             // solo para los mensajes de error
+    const char *name;       // dentro del padre (en path)
+    atomic_int pending;
+    bool failed;            // no se pudo abrir: no se intenta borrar
+    struct tDelJob *job;
+} tDelNode;
+
+typedef struct tDelJob {
+    tExecutor *ex;          // NULL: en el hilo que llama, desde queue
+    tVector queue;          // tDelNode* pendientes sin ejecutor
+    bool count;             // contar entradas y bytes liberados
+    atomic_ullong entries;
+    atomic_ullong bytes;
+    atomic_int status;
+    pthread_mutex_t lock;
+    pthread_cond_t done_cv;
+    bool done;
+} tDelJob;
+
+static void delrec_error(const char *dir, const char *name){
+    int e = errno;
+    char *full = join_path(dir, name);
+    errno = e;
+    perror(full ? full : name);
+    free(full);
+}
+
+static void del_scan(void *arg);
+
+static void del_submit(tDelJob *j, tDelNode *n){
+    if (j->ex) {
+        // Sin memoria para encolar: se hace aquí mismo
+        if (executor_submit(j->ex, del_scan, n) != 0) del_scan(n);
+    } else if (!vector_push(&j->queue, &n)) {
+        del_scan(n);
+    }
+}
+
+static tDelNode *del_node(tDelJob *j, tDelNode *parent, const char *name){
+    tDelNode *n = malloc(sizeof *n);
+    char *path = parent ? join_path(parent->path, name) : strdup(name);
+    if (!n || !path) {
+        errno = ENOMEM;
+        delrec_error(parent ? parent->path : ".", name);
+        free(n); free(path);
+        return NULL;
+    }
+    n->parent = parent;
+    n->fd = -1;
+    n->path = path;
+    n->name = parent ? strrchr(path, '/') + 1 : path;
+    atomic_init(&n->pending, 1);
+    n->failed = false;
+    n->job = j;
+    return n;
+}
+
+// Un hijo (o la propia lectura) ha terminado; el último borra el directorio
+static void del_release(tDelNode *n){
+    while (n && atomic_fetch_sub(&n->pending, 1) == 1) {
+        tDelJob *j = n->job;
+        tDelNode *parent = n->parent;
+        if (n->fd != -1) close(n->fd);
+        int pfd = parent ? parent->fd : AT_FDCWD;
+        if (n->failed) {
+            atomic_store(&j->status, 1);
+        } else if (unlinkat(pfd, parent ? n->name : n->path,
+                            AT_REMOVEDIR) == -1) {
+            perror(n->path);
+            atomic_store(&j->status, 1);
+        } else {
+            atomic_fetch_add(&j->entries, 1);
+        }
+        free(n->path);
+        free(n);
+        if (!parent) {
+            pthread_mutex_lock(&j->lock);
+            j->done = true;
+            pthread_cond_signal(&j->done_cv);
+            pthread_mutex_unlock(&j->lock);
+        }
+        n = parent;
+    }
+}
+
+static void del_scan(void *arg){
+    tDelNode *n = arg;
+    tDelJob *j = n->job;
+    int pfd = n->parent ? n->parent->fd : AT_FDCWD;
+    n->fd = openat(pfd, n->parent ? n->name : n->path,
+                   O_RDONLY | O_DIRECTORY | O_NOFOLLOW | O_CLOEXEC);
+    tDirReader rd;
+    if (n->fd == -1 || dreader_init(&rd, n->fd) != 0) {
+        perror(n->path);
+        n->failed = true;
+        del_release(n);
+        return;
+    }
+    unsigned need = j->count ? META_SIZE | META_NLINK : 0;
+    unsigned long long entries = 0, bytes = 0;
+    tDirEntry de;
+    int more;
+    while ((more = dreader_next(&rd, &de)) > 0) {
+        bool is_dir = de.type == ENT_DIR;
+        tMeta m;
+        if (de.type == ENT_UNKNOWN || (j->count && !is_dir)) {
+            if (meta_one(n->fd, de.name, need, &m) == -1) {
+                delrec_error(n->path, de.name);
+                atomic_store(&j->status, 1);
+                continue;
+            }
+            is_dir = S_ISDIR(m.mode);
+        }
+        if (is_dir) {
+            tDelNode *c = del_node(j, n, de.name);
+            if (!c) { atomic_store(&j->status, 1); continue; }
+            atomic_fetch_add(&n->pending, 1);
+            del_submit(j, c);
+        } else if (unlinkat(n->fd, de.name, 0) == -1) {
+            delrec_error(n->path, de.name);
+            atomic_store(&j->status, 1);
+        } else {
+            ++entries;
+            // Con más enlaces el espacio sigue ocupado
+            if (j->count && m.nlink <= 1) bytes += (unsigned long long)m.size;
+        }
+    }
+    if (more < 0) { perror(n->path); atomic_store(&j->status, 1); }
+    dreader_free(&rd);
+    atomic_fetch_add(&j->entries, entries);
+    atomic_fetch_add(&j->bytes, bytes);
+    del_release(n);
+}
+
+static int delrec_path(const char *path, int threads){
+    tDelJob j;
+    memset(&j, 0, sizeof j);
+    j.count = threads >= 0;
+    atomic_init(&j.entries, 0);
+    atomic_init(&j.bytes, 0);
+    atomic_init(&j.status, 0);
+
+    tMeta m;
+    if (meta_one(AT_FDCWD, path, META_SIZE | META_NLINK, &m) == -1) {
+        perror(path);
+        return 1;
+    }
+    if (!S_ISDIR(m.mode)) {
+        if (unlink(path) == -1) { perror(path); return 1; }
+        atomic_store(&j.entries, 1);
+        if (m.nlink <= 1) atomic_store(&j.bytes, (unsigned long long)m.size);
+    } else {
+        tDelNode *root = del_node(&j, NULL, path);
+        if (!root) return 1;
+        pthread_mutex_init(&j.lock, NULL);
+        pthread_cond_init(&j.done_cv, NULL);
+        vector_init(&j.queue, sizeof(tDelNode *));
+        int nthreads = threads == 0 ? hilos_online() : threads;
+        if (nthreads > 1) j.ex = executor_create(nthreads);
+        if (j.ex) {
+            del_submit(&j, root);
+            pthread_mutex_lock(&j.lock);
+            while (!j.done) pthread_cond_wait(&j.done_cv, &j.lock);
+            pthread_mutex_unlock(&j.lock);
+            executor_destroy(j.ex);
+        } else {
+            // Pila LIFO: recorrido en profundidad, pocos directorios abiertos
+            del_scan(root);
+            while (j.queue.len) {
+                tDelNode *n = *(tDelNode **)vector_at(&j.queue, j.queue.len - 1);
+                vector_pop(&j.queue);
+                del_scan(n);
+            }
+        }
+        vector_free(&j.queue);
+        pthread_mutex_destroy(&j.lock);
+        pthread_cond_destroy(&j.done_cv);
+    }
+    if (j.count)
+        printf("%s: %llu entries, %llu bytes reclaimed\n", path,
+               (unsigned long long)atomic_load(&j.entries),
+               (unsigned long long)atomic_load(&j.bytes));
+    return atomic_load(&j.status);
+}
+
+/* delrec [-j N] n1 [n2 ...]: con -j se borra con N hilos (0 = uno por CPU)
+ * y se informa de las entradas y bytes liberados */
 int cmd_delrec(int argc, char *argv[]){
-    if (argc < 2) { fprintf(stderr, "Usage: delrec n1 [n2 ...]\n"); return 1; }
+    int i = 1, threads = -1;
+    if (i < argc && strcmp(argv[i], "-j") == 0) {
+        char *end;
+        long t = i + 1 < argc ? strtol(argv[i + 1], &end, 10) : -1;
+        if (t < 0 || t > HILOS_MAX || *argv[i + 1] == '\0' || *end != '\0') {
+            fprintf(stderr, "delrec: -j must be 0..%d\n", HILOS_MAX);
+            return 1;
+        }
+        threads = (int)t;
+        i += 2;
+    }
+    if (i >= argc) {
+        fprintf(stderr, "Usage: delrec [-j N] n1 [n2 ...]\n");
+        return 1;
+    }
     int status = 0;
-    for (int i = 1; i < argc; ++i) {
-        if (delrec_path(argv[i]) != 0) status = 1;
+    for (; i < argc; ++i) {
+        if (delrec_path(argv[i], threads) != 0) status = 1;
     }
     return status;
 }
 
+// Descriptor de la lista de abiertos o -1 (con el mensaje ya escrito)
+static int tracked_fd(const char *cmd, const char *arg){
+    char *endp = NULL;
+    errno = 0;
+    long lfd = strtol(arg, &endp, 10);
+    if (*arg == '\0' || *endp != '\0' || errno || lfd < 0 || lfd > INT_MAX) {
+        fprintf(stderr, "%s: invalid fd '%s'\n", cmd, arg);
+        return -1;
+    }
+    if (!file_list_ready() || !lookup_fd((int)lfd)) {
+        fprintf(stderr, "%s: fd %ld not found in open list\n", cmd, lfd);
+        return -1;
+    }
+    return (int)lfd;
+}
+
+static bool same_file(const struct stat *a, const struct stat *b){
+    return a->st_dev == b->st_dev && a->st_ino == b->st_ino;
+}
+
+/* copy [-o] src dst | copy src dst -fd: copia el fichero src en dst (que
+ * no debe existir salvo con -o) o, con -fd, del descriptor src al dst de
+ * la lista de abiertos desde sus posiciones actuales */
+int cmd_copy(int argc, char *argv[]){
+    bool use_fd = false, overwrite = false;
+    const char *args[2];
+    int nargs = 0;
+    for (int i = 1; i < argc; ++i) {
+        if (strcmp(argv[i], "-fd") == 0) use_fd = true;
+        else if (strcmp(argv[i], "-o") == 0) overwrite = true;
+        else if (nargs < 2) args[nargs++] = argv[i];
+        else { nargs = 3; break; }
+    }
+    if (nargs != 2 || (use_fd && overwrite)) {
+        fprintf(stderr, "Usage: copy [-o] src dst | copy src dst -fd\n");
+        return 1;
+    }
+    int in = -1, out = -1;
+    struct stat si, so;
+    if (use_fd) {
+        if ((in = tracked_fd("copy", args[0])) < 0 ||
+            (out = tracked_fd("copy", args[1])) < 0) return 1;
+        if (fstat(in, &si) == 0 && fstat(out, &so) == 0 &&
+            S_ISREG(si.st_mode) && same_file(&si, &so)) {
+            fprintf(stderr, "copy: %s and %s are the same file\n",
+                    args[0], args[1]);
+            return 1;
+        }
+    } else {
+        in = open(args[0], O_RDONLY | O_CLOEXEC);
+        if (in == -1 || fstat(in, &si) == -1) {
+            perror(args[0]);
+            if (in != -1) close(in);
+            return 1;
+        }
+        if (S_ISDIR(si.st_mode)) {
+            fprintf(stderr, "copy: %s: %s\n", args[0], strerror(EISDIR));
+            close(in);
+            return 1;
+        }
+        // Con -o, O_TRUNC vaciaría el origen antes de leerlo
+        if (stat(args[1], &so) == 0 && same_file(&si, &so)) {
+            fprintf(stderr, "copy: %s and %s are the same file\n",
+                    args[0], args[1]);
+            close(in);
+            return 1;
+        }
+        int flags = O_WRONLY | O_CREAT | O_CLOEXEC |
+                    (overwrite ? O_TRUNC : O_EXCL);
+        out = open(args[1], flags, si.st_mode & 0777);
+        if (out == -1) {
+            perror(args[1]);
+            close(in);
+            return 1;
+        }
+    }
+    if (use_fd && (item_flush(lookup_fd(in)) != 0 ||
+                   item_flush(lookup_fd(out)) != 0)) {
+        perror("flush");
+        return 1;
+    }
+    copy_method_t method;
+    fflush(stdout);     // out puede ser la salida estándar
+    long long n = copia_fd(in, out, &method);
+    int err = errno;
+    if (!use_fd) {
+        if (close(out) == -1 && n >= 0) { n = -1; err = errno; }
+        close(in);
+    }
+    if (n < 0) {
+        fprintf(stderr, "copy: %s -> %s: %s\n", args[0], args[1],
+                strerror(err));
+        return 1;
+    }
+    printf("Copied %lld bytes from %s to %s (%s)\n", n, args[0], args[1],
+           copia_method_name(method));
+    return 0;
+}
+
 int cmd_lseek(int argc, char *argv[]){
     if (argc != 4) {
         fprintf(stderr, "Usage: lseek df off SEEK_SET|SEEK_CUR|SEEK_END\n");
@@ -565,25 +2002,13 @@ int cmd_lseek(int argc, char *argv[]){
         fprintf(stderr, "lseek: invalid whence '%s'\n", argv[3]);
         return 1;
     }
+    if (ficheros_flush(fd) != 0) { perror("flush"); return 1; }
     off_t pos = lseek(fd, off, whence);
     if (pos == (off_t)-1) { perror("lseek"); return 1; }
     printf("%jd\n", (intmax_t)pos);
     return 0;
 }
 
-static int write_all(int fd, const char *buf, size_t len){
-    size_t done = 0;
-    while (done < len) {
-        ssize_t n = write(fd, buf + done, len - done);
-        if (n == -1) {
-            if (errno == EINTR) continue;
-            return -1;
-        }
-        done += (size_t)n;
-    }
-    return 0;
-}
-
 int cmd_writestr(int argc, char *argv[]){
     if (argc < 3) { fprintf(stderr, "Usage: writestr df str\n"); return 1; }
     int fd = get_fd(argv);
@@ -596,18 +2021,56 @@ int cmd_writestr(int argc, char *argv[]){
             "(open with 'wo' or 'rw')\n", fd);
         return 1;
     }
-    char buf[8192]; size_t pos = 0;
-    for (int i = 2; i < argc; ++i) {
-        size_t w = strlen(argv[i]);
-        if (pos + w + 1 >= sizeof buf) {
-            fprintf(stderr, "writestr: string too long\n");
-            return 1;
+    // Argumentos y separadores directamente desde argv, sin copiarlos
+    static char sep[] = " ";
+    size_t nwords = (size_t)argc - 2, cnt = 2 * nwords - 1, total = 0;
+    struct iovec *iov = malloc(cnt * sizeof *iov);
+    if (!iov) { perror("malloc"); return 1; }
+    for (size_t i = 0; i < nwords; ++i) {
+        iov[2 * i].iov_base = argv[i + 2];
+        iov[2 * i].iov_len = strlen(argv[i + 2]);
+        total += iov[2 * i].iov_len;
+        if (i + 1 < nwords) {
+            iov[2 * i + 1].iov_base = sep;
+            iov[2 * i + 1].iov_len = 1;
+            ++total;
         }
-        memcpy(buf + pos, argv[i], w);
-        pos += w;
-        if (i + 1 < argc) buf[pos++] = ' ';
     }
-    if (write_all(fd, buf, pos) == -1) { perror("write"); return 1; }
-    printf("%zu bytes written\n", pos);
+    int r = item_write_iov(lookup_fd(fd), fd, iov, cnt, total);
+    free(iov);
+    if (r == -1) { perror("writev"); return 1; }
+    printf("%zu bytes written\n", total);
     return 0;
 }
+
+static int flush_item(tItemF *it){
+    size_t pending = it->wlen;
+    if (item_flush(it) != 0) { perror(it->filename); return 1; }
+    printf("Flushed %zu bytes to [%d] %s\n", pending, it->fileDescriptor,
+           it->filename);
+    return 0;
+}
+
+/* flush [fd]: escribe lo pendiente en el buffer de fd o, sin argumentos,
+ * en el de todos los descriptores de la lista que lo tengan */
+int cmd_flush(int argc, char *argv[]){
+    if (!file_list_ready()) return 1;
+    if (argc > 2) { fprintf(stderr, "Usage: flush [fd]\n"); return 1; }
+    if (argc == 2) {
+        int fd = tracked_fd("flush", argv[1]);
+        if (fd < 0) return 1;
+        tItemF *it = lookup_fd(fd);
+        if (!it->wbuf) {
+            fprintf(stderr, "flush: fd %d has no buffer (open with buf=N)\n",
+                    fd);
+            return 1;
+        }
+        return flush_item(it);
+    }
+    int status = 0;
+    for (size_t fd = 0; fd < open_files.len; ++fd) {
+        tItemF *it = lookup_fd((int)fd);
+        if (it && it->wbuf) status |= flush_item(it);
+    }
+    return status;
+}
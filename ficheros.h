@@ -5,6 +5,7 @@
 #define FICHEROS_H
 
 #define MAX 1024
+#define OPEN_BUF_MAX (64u << 20)   /* buf=N de open */
 #define _POSIX_C_SOURCE 200809L
 
 #pragma once
@@ -14,41 +15,61 @@
 #include <errno.h>
 #include <time.h>
 #include <pwd.h>
+#include <pthread.h>
 #include <inttypes.h>
 #include <grp.h>
 #include <dirent.h>
 #include <fcntl.h>
+#include <fnmatch.h>
 #include <limits.h>
 #include <sys/types.h>
 #include <sys/stat.h>
+#include <sys/uio.h>
 #include <unistd.h>
 #include <string.h>
 #include <stdlib.h>
 
 #include "lista.h"
+#include "contenedores.h"
 #include "p3.h"
+#include "hilos.h"
+#include "recorrido.h"
+#include "metadatos.h"
+#include "cachedir.h"
+#include "copia.h"
+#include "asincrono.h"
 
 typedef struct tItemF{
 
     int fileDescriptor;
-    char filename[MAX];
+    char *filename;             /* ruta fuera de línea (strdup) */
     int mode;
+    struct tItemF *name_next;   /* siguiente descriptor con la misma ruta */
+    char *wbuf;                 /* buffer de escritura (NULL: sin buffer) */
+    size_t wlen;                /* bytes pendientes en wbuf */
+    size_t wcap;
 
 }tItemF;
 
 typedef enum { DIR_REC_NOREC = 0, DIR_REC_RECA, DIR_REC_RECB } dir_rec_t;
+typedef enum { DIR_SORT_NONE = 0, DIR_SORT_NAME, DIR_SORT_SIZE,
+               DIR_SORT_MTIME } dir_sort_t;
 
 typedef struct {
     bool longfmt;    /* long|short */
     bool showlink;   /* link|nolink */
     bool showhid;    /* hid|nohid */
     dir_rec_t rec;   /* norec|reca|recb */
+    int threads;     /* hilos para dir -d recursivo (0 = uno por CPU) */
+    meta_backend_t meta;  /* auto|uring|threads|sync para los metadatos */
+    dir_sort_t sort; /* none (orden del directorio)|name|size|mtime */
+    bool cache;      /* cache|nocache: reutilizar listados sin cambios */
 } DirParams;
 
 const DirParams *dirparams_get(void);
 
 tItemF *make_itemF(int fd, const char *name, int mode);
-int addFile(List *lista, const char *path, int flags);
+int addFile(const char *path, int flags);
 void delFile(void *data);
 char *convertMode(mode_t m, char *permisos);
 char *convertMode2(mode_t m);
@@ -57,6 +78,15 @@ char *convertMode3(mode_t m);
 void ficheros_init(void);
 void ficheros_shutdown(void);
 
+/* Escrituras sobre descriptores de la lista: si se abrió con buf=N, se
+ * acumulan y salen en una sola llamada al llenarse el buffer o al vaciarlo
+ * (flush, close, lseek, read o antes de fork). Devuelve n o -1 con errno. */
+ssize_t ficheros_write(int fd, const void *buf, size_t n);
+// Vacía el buffer de fd (0 si no tiene); -1 con errno
+int ficheros_flush(int fd);
+// Antes de fork: el hijo no debe heredar datos pendientes
+void ficheros_flush_all(void);
+
 int cmd_listOpen(int argc, char **argv);
 int cmd_open(int argc, char **argv);
 int cmd_close (int argc, char *argv[]);
@@ -67,6 +97,10 @@ int cmd_setdirparams(int argc, char *argv[]);
 int cmd_getdirparams(int argc, char *argv[]);
 int cmd_dir(int argc, char *argv[]);
 int cmd_delrec(int argc, char *argv[]);
+int cmd_find(int argc, char *argv[]);
+int cmd_du(int argc, char *argv[]);
+int cmd_copy(int argc, char *argv[]);
 int cmd_lseek(int argc, char *argv[]);
+int cmd_flush(int argc, char *argv[]);
 int cmd_writestr(int argc, char *argv[]);
 #endif //FICHEROS_H
@@ -0,0 +1,51 @@
+// Pablo Araújo Rodríguez   pablo.araujo@udc.es
+// Uriel Liñares Vaamonde   uriel.linaresv@udc.es
+
+/* Genera comandos_phash.h: busca una semilla para la que cmd_phash no tenga
+ * colisiones sobre los nombres de comandos.def y vuelca la tabla de huecos
+ * (hueco -> índice en la tabla de comandos, -1 si vacío). */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "phash.h"
+
+static const char *names[] = {
+#define CMD(name, fn, help) name,
+#include "comandos.def"
+#undef CMD
+};
+
+#define N_NAMES (sizeof names / sizeof names[0])
+
+int main(void) {
+    // Tabla de al menos 4 huecos por nombre: la búsqueda de semilla es rápida
+    unsigned bits = 1;
+    while ((1u << bits) < 4 * N_NAMES) bits++;
+    size_t size = (size_t)1 << bits;
+    short *slots = malloc(size * sizeof *slots);
+    if (!slots) { perror("malloc"); return 1; }
+    for (uint32_t seed = 1; seed != 0; ++seed) {
+        for (size_t i = 0; i < size; ++i) slots[i] = -1;
+        size_t i;
+        for (i = 0; i < N_NAMES; ++i) {
+            size_t h = cmd_phash(names[i], seed) & (size - 1);
+            if (slots[h] != -1) break;
+            slots[h] = (short)i;
+        }
+        if (i < N_NAMES) continue;
+        printf("/* Generado por gen_phash a partir de comandos.def: no editar */\n");
+        printf("#define CMD_PHASH_SEED 0x%08xu\n", seed);
+        printf("#define CMD_PHASH_SIZE %zu\n", size);
+        printf("#define CMD_PHASH_COUNT %zu\n", (size_t)N_NAMES);
+        printf("static const short cmd_phash_slots[CMD_PHASH_SIZE] = {");
+        for (size_t k = 0; k < size; ++k)
+            printf("%s%d,", (k % 16) ? " " : "\n    ", slots[k]);
+        printf("\n};\n");
+        free(slots);
+        return 0;
+    }
+    fprintf(stderr, "gen_phash: no collision-free seed found\n");
+    free(slots);
+    return 1;
+}
@@ -0,0 +1,216 @@
+// Pablo Araújo Rodríguez   pablo.araujo@udc.es
+// Uriel Liñares Vaamonde   uriel.linaresv@udc.es
+
+#define _POSIX_C_SOURCE 200809L
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include "hilos.h"
+
+typedef struct {
+    task_fn fn;
+    void *arg;
+} tTask;
+
+// Cola doble circular protegida por su propio cerrojo
+typedef struct {
+    pthread_mutex_t lock;
+    tTask *buf;
+    size_t cap;     // potencia de dos
+    size_t head;    // extremo de robo
+    size_t tail;    // extremo del dueño
+} tDeque;
+
+struct tExecutor {
+    int nworkers;               // hilos realmente arrancados
+    int ndeques;                // pedidos + 1 (la última es la externa)
+    pthread_t *threads;
+    tDeque *deques;
+    pthread_mutex_t idle_lock;
+    pthread_cond_t idle_cv;
+    atomic_size_t pending;      // tareas encoladas aún sin sacar
+    atomic_int sleepers;
+    atomic_bool stop;
+    pid_t owner;                // proceso en el que viven los hilos
+};
+
+typedef struct {
+    tExecutor *ex;
+    int id;
+} tWorkerArg;
+
+// Hilo actual: índice de trabajador o -1 fuera del ejecutor
+static _Thread_local int tl_worker = -1;
+static _Thread_local tExecutor *tl_executor = NULL;
+
+static int deque_init(tDeque *d) {
+    d->cap = 64;
+    d->head = d->tail = 0;
+    d->buf = malloc(d->cap * sizeof *d->buf);
+    if (!d->buf) return -1;
+    pthread_mutex_init(&d->lock, NULL);
+    return 0;
+}
+
+static void deque_destroy(tDeque *d) {
+    pthread_mutex_destroy(&d->lock);
+    free(d->buf);
+}
+
+static int deque_push(tDeque *d, tTask t) {
+    pthread_mutex_lock(&d->lock);
+    if (d->tail - d->head == d->cap) {
+        tTask *nb = malloc(2 * d->cap * sizeof *nb);
+        if (!nb) { pthread_mutex_unlock(&d->lock); return -1; }
+        for (size_t i = d->head; i != d->tail; ++i)
+            nb[i & (2 * d->cap - 1)] = d->buf[i & (d->cap - 1)];
+        free(d->buf);
+        d->buf = nb;
+        d->cap *= 2;
+    }
+    d->buf[d->tail++ & (d->cap - 1)] = t;
+    pthread_mutex_unlock(&d->lock);
+    return 0;
+}
+
+static bool deque_pop(tDeque *d, tTask *out) {
+    pthread_mutex_lock(&d->lock);
+    bool ok = d->tail != d->head;
+    if (ok) *out = d->buf[--d->tail & (d->cap - 1)];
+    pthread_mutex_unlock(&d->lock);
+    return ok;
+}
+
+static bool deque_steal(tDeque *d, tTask *out) {
+    pthread_mutex_lock(&d->lock);
+    bool ok = d->tail != d->head;
+    if (ok) *out = d->buf[d->head++ & (d->cap - 1)];
+    pthread_mutex_unlock(&d->lock);
+    return ok;
+}
+
+static bool find_task(tExecutor *ex, int self, unsigned *seed, tTask *t) {
+    if (deque_pop(&ex->deques[self], t)) return true;
+    // Víctima inicial pseudoaleatoria para repartir los robos
+    int n = ex->ndeques;
+    *seed = *seed * 1103515245u + 12345u;
+    int start = (int)((*seed >> 16) % (unsigned)n);
+    for (int k = 0; k < n; ++k) {
+        int v = (start + k) % n;
+        if (v != self && deque_steal(&ex->deques[v], t)) return true;
+    }
+    return false;
+}
+
+static void *worker_main(void *p) {
+    tWorkerArg *wa = p;
+    tExecutor *ex = wa->ex;
+    int self = wa->id;
+    free(wa);
+    tl_worker = self;
+    tl_executor = ex;
+    unsigned seed = (unsigned)self * 2654435761u + 1u;
+    for (;;) {
+        tTask t;
+        if (find_task(ex, self, &seed, &t)) {
+            atomic_fetch_sub(&ex->pending, 1);
+            t.fn(t.arg);
+            continue;
+        }
+        pthread_mutex_lock(&ex->idle_lock);
+        atomic_fetch_add(&ex->sleepers, 1);
+        while (atomic_load(&ex->pending) == 0 && !atomic_load(&ex->stop))
+            pthread_cond_wait(&ex->idle_cv, &ex->idle_lock);
+        atomic_fetch_sub(&ex->sleepers, 1);
+        bool done = atomic_load(&ex->stop) && atomic_load(&ex->pending) == 0;
+        pthread_mutex_unlock(&ex->idle_lock);
+        if (done) break;
+    }
+    tl_worker = -1;
+    tl_executor = NULL;
+    return NULL;
+}
+
+tExecutor *executor_create(int nworkers) {
+    if (nworkers < 1) nworkers = 1;
+    if (nworkers > HILOS_MAX) nworkers = HILOS_MAX;
+    tExecutor *ex = calloc(1, sizeof *ex);
+    if (!ex) return NULL;
+    ex->deques = calloc((size_t)nworkers + 1, sizeof *ex->deques);
+    ex->threads = calloc((size_t)nworkers, sizeof *ex->threads);
+    if (!ex->deques || !ex->threads) goto fail;
+    for (int i = 0; i <= nworkers; ++i) {
+        if (deque_init(&ex->deques[i]) != 0) {
+            for (int j = 0; j < i; ++j) deque_destroy(&ex->deques[j]);
+            goto fail;
+        }
+    }
+    ex->ndeques = nworkers + 1;
+    pthread_mutex_init(&ex->idle_lock, NULL);
+    pthread_cond_init(&ex->idle_cv, NULL);
+    atomic_init(&ex->pending, 0);
+    atomic_init(&ex->sleepers, 0);
+    atomic_init(&ex->stop, false);
+    ex->owner = getpid();
+    for (int i = 0; i < nworkers; ++i) {
+        tWorkerArg *wa = malloc(sizeof *wa);
+        if (wa) { wa->ex = ex; wa->id = i; }
+        if (!wa ||
+            pthread_create(&ex->threads[i], NULL, worker_main, wa) != 0) {
+            free(wa);
+            break;  // seguimos con los hilos que sí se crearon
+        }
+        ex->nworkers++;
+    }
+    if (ex->nworkers == 0) {
+        executor_destroy(ex);
+        return NULL;
+    }
+    return ex;
+fail:
+    free(ex->deques);
+    free(ex->threads);
+    free(ex);
+    return NULL;
+}
+
+int executor_submit(tExecutor *ex, task_fn fn, void *arg) {
+    tTask t = { fn, arg };
+    // Desde un trabajador, a su propia cola; si no, a la externa
+    int q = (tl_executor == ex && tl_worker >= 0) ? tl_worker
+                                                  : ex->ndeques - 1;
+    if (deque_push(&ex->deques[q], t) != 0) return -1;
+    atomic_fetch_add(&ex->pending, 1);
+    if (atomic_load(&ex->sleepers) > 0) {
+        pthread_mutex_lock(&ex->idle_lock);
+        pthread_cond_signal(&ex->idle_cv);
+        pthread_mutex_unlock(&ex->idle_lock);
+    }
+    return 0;
+}
+
+void executor_destroy(tExecutor *ex) {
+    if (!ex) return;
+    /* En un hijo de fork() los hilos no existen y los cerrojos pueden haber
+     * quedado tomados: no hay a quién esperar y el proceso va a terminar */
+    if (getpid() != ex->owner) return;
+    pthread_mutex_lock(&ex->idle_lock);
+    atomic_store(&ex->stop, true);
+    pthread_cond_broadcast(&ex->idle_cv);
+    pthread_mutex_unlock(&ex->idle_lock);
+    for (int i = 0; i < ex->nworkers; ++i) pthread_join(ex->threads[i], NULL);
+    for (int i = 0; i < ex->ndeques; ++i) deque_destroy(&ex->deques[i]);
+    pthread_mutex_destroy(&ex->idle_lock);
+    pthread_cond_destroy(&ex->idle_cv);
+    free(ex->deques);
+    free(ex->threads);
+    free(ex);
+}
+
+int hilos_online(void) {
+    long n = sysconf(_SC_NPROCESSORS_ONLN);
+    if (n < 1) n = 1;
+    if (n > HILOS_MAX) n = HILOS_MAX;
+    return (int)n;
+}
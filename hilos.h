@@ -0,0 +1,30 @@
+// Pablo Araújo Rodríguez   pablo.araujo@udc.es
+// Uriel Liñares Vaamonde   uriel.linaresv@udc.es
+
+#ifndef HILOS_H
+#define HILOS_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#define HILOS_MAX 64
+
+/* Ejecutor con robo de trabajo: cada hilo tiene su propia cola doble.
+ * El dueño apila y desapila por el final (LIFO, buena localidad) y los
+ * hilos ociosos roban por el principio (las tareas más antiguas, que
+ * suelen ser las más grandes). Las tareas enviadas desde fuera del
+ * ejecutor van a una cola adicional de la que todos roban. */
+typedef void (*task_fn)(void *arg);
+
+typedef struct tExecutor tExecutor;
+
+tExecutor *executor_create(int nworkers);
+// Encola una tarea; devuelve -1 si no hay memoria (la tarea no se ejecutará)
+int executor_submit(tExecutor *ex, task_fn fn, void *arg);
+// Espera a que se vacíen las colas y termina los hilos
+void executor_destroy(tExecutor *ex);
+
+// Hilos disponibles en la máquina (entre 1 y HILOS_MAX)
+int hilos_online(void);
+
+#endif //HILOS_H
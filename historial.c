@@ -0,0 +1,409 @@
+// Pablo Araújo Rodríguez   pablo.araujo@udc.es
+// Uriel Liñares Vaamonde   uriel.linaresv@udc.es
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <stdint.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include "historial.h"
+#include "contenedores.h"
+
+typedef struct {
+    int id;
+    size_t off;     /* posición en la arena */
+    size_t len;     /* sin contar el '\0' */
+    size_t span;    /* bytes ocupados: texto, '\0' y hueco de argumentos */
+    int argc;       /* -1 mientras no se adjunten los argumentos */
+} tHistEntry;
+
+static tHistEntry *ring = NULL;
+static size_t ring_cap = 0;     /* máximo de entradas */
+static size_t ring_tail = 0;    /* entrada más antigua */
+static size_t ring_count = 0;
+static char *arena = NULL;
+static size_t arena_cap = 0;
+static size_t arena_wpos = 0;
+static int next_id = 0;
+
+static struct {
+    int data_fd;
+    int idx_fd;
+    const char *data;       /* proyección del fichero de registros */
+    size_t data_len;
+    const uint64_t *idx;    /* proyección del índice */
+    size_t idx_map;         /* bytes proyectados del índice */
+    size_t idx_len;         /* entradas válidas proyectadas */
+    size_t count;           /* entradas totales en el registro */
+    /* Otras sesiones añaden a la vez: los ids por debajo de base son
+     * posiciones del registro, los siguientes se traducen con pos */
+    size_t base;
+    tVector pos;            /* uint64_t: posición de base, base + 1... */
+} hlog = { -1, -1, NULL, 0, NULL, 0, 0, 0, 0, { NULL, 0, 0, sizeof(uint64_t) } };
+
+#define LOG_NONE UINT64_MAX
+
+static bool log_lookup(int id, tItemH *out);
+static uint64_t log_append(const char *line, size_t len);
+static void log_forget(void);
+
+static size_t arena_size_for(size_t max_entries) {
+    size_t bytes = max_entries * HISTORY_ARENA_PER_ENTRY;
+    return bytes < HISTORY_ARENA_MIN ? HISTORY_ARENA_MIN : bytes;
+}
+
+static tHistEntry *entry_at(size_t k) {
+    return &ring[(ring_tail + k) % ring_cap];
+}
+
+static void evict_oldest(void) {
+    ring_tail = (ring_tail + 1) % ring_cap;
+    ring_count--;
+}
+
+int history_init(size_t max_entries) {
+    if (max_entries == 0) { errno = EINVAL; return -1; }
+    size_t acap = arena_size_for(max_entries);
+    tHistEntry *nring = malloc(max_entries * sizeof *nring);
+    char *narena = malloc(acap);
+    if (!nring || !narena) {
+        free(nring);
+        free(narena);
+        errno = ENOMEM;
+        return -1;
+    }
+    history_shutdown();
+    ring = nring;
+    ring_cap = max_entries;
+    arena = narena;
+    arena_cap = acap;
+    next_id = 0;
+    return 0;
+}
+
+void history_shutdown(void) {
+    free(ring);
+    free(arena);
+    ring = NULL;
+    arena = NULL;
+    ring_cap = arena_cap = 0;
+    ring_tail = ring_count = arena_wpos = 0;
+}
+
+/* Vacía el anillo y oculta a esta sesión lo ya registrado; el fichero no
+ * se toca, otras sesiones lo tienen proyectado */
+void history_clear(void) {
+    ring_tail = 0;
+    ring_count = 0;
+    arena_wpos = 0;
+    next_id = 0;
+    log_forget();
+}
+
+size_t history_max(void) { return ring_cap; }
+
+static bool overlaps(const tHistEntry *e, size_t start, size_t need) {
+    return e->off < start + need && start < e->off + e->span;
+}
+
+/* Cada entrada reserva tras su texto otro tanto para los argumentos
+ * troceados: quitar comillas y escapes nunca alarga la línea. */
+static tHistEntry *store_entry(int id, const char *line, size_t len) {
+    size_t need = 2 * (len + 1);
+    if (need > arena_cap) { errno = E2BIG; return NULL; }
+    if (ring_count == ring_cap) evict_oldest();
+    if (arena_wpos + need > arena_cap) {
+        // Vuelta al principio: lo que queda al final es de la vuelta anterior
+        while (ring_count && entry_at(0)->off >= arena_wpos) evict_oldest();
+        arena_wpos = 0;
+    }
+    while (ring_count && overlaps(entry_at(0), arena_wpos, need))
+        evict_oldest();
+    tHistEntry *e = &ring[(ring_tail + ring_count) % ring_cap];
+    e->id = id;
+    e->off = arena_wpos;
+    e->len = len;
+    e->span = need;
+    e->argc = -1;
+    memcpy(arena + arena_wpos, line, len);
+    arena[arena_wpos + len] = '\0';
+    arena_wpos += need;
+    ring_count++;
+    return e;
+}
+
+static tHistEntry *ring_find(int id) {
+    if (ring_count == 0) return NULL;
+    int first = entry_at(0)->id;
+    if (id < first || id >= first + (int)ring_count) return NULL;
+    return entry_at((size_t)(id - first));
+}
+
+int history_set_max(size_t max_entries) {
+    if (max_entries == 0) { errno = EINVAL; return -1; }
+    // Conserva las entradas más recientes que quepan en el nuevo anillo
+    tHistEntry *old_ring = ring;
+    char *old_arena = arena;
+    size_t old_cap = ring_cap, old_tail = ring_tail, old_count = ring_count;
+    int old_next = next_id;
+    ring = NULL;
+    arena = NULL;
+    if (history_init(max_entries) != 0) {
+        ring = old_ring; arena = old_arena;
+        return -1;
+    }
+    size_t skip = old_count > max_entries ? old_count - max_entries : 0;
+    for (size_t k = skip; k < old_count; ++k) {
+        const tHistEntry *e = &old_ring[(old_tail + k) % old_cap];
+        tHistEntry *n = store_entry(e->id, old_arena + e->off, e->len);
+        if (n && e->argc >= 0) {
+            memcpy(arena + n->off + n->len + 1, old_arena + e->off + e->len + 1,
+                   e->len + 1);
+            n->argc = e->argc;
+        }
+    }
+    next_id = old_next;
+    free(old_ring);
+    free(old_arena);
+    return 0;
+}
+
+int history_add(const char *line) {
+    if (!ring && history_init(HISTORY_MAX) != 0) return -1;
+    size_t len = strlen(line);
+    if (!store_entry(next_id, line, len)) return -1;
+    // Sin hueco para su posición la línea no se guarda (los ids no se desfasan)
+    uint64_t none = LOG_NONE, *pos;
+    if (history_log_active() &&
+        (pos = vector_push(&hlog.pos, &none)))
+        *pos = log_append(line, len);
+    return next_id++;
+}
+
+int history_set_args(int id, char *const argv[], int argc) {
+    tHistEntry *e = ring_find(id);
+    if (!e) { errno = ENOENT; return -1; }
+    char *dst = arena + e->off + e->len + 1;
+    size_t room = e->len + 1, used = 0;
+    for (int i = 0; i < argc; ++i) {
+        size_t n = strlen(argv[i]) + 1;
+        if (used + n > room) { errno = E2BIG; return -1; }
+        memcpy(dst + used, argv[i], n);
+        used += n;
+    }
+    e->argc = argc;
+    return 0;
+}
+
+bool history_get(int id, tItemH *out) {
+    const tHistEntry *e = ring_find(id);
+    if (!e) return log_lookup(id, out);
+    if (out) {
+        out->id = e->id;
+        out->name = arena + e->off;
+        out->argc = e->argc;
+        out->args = e->argc >= 0 ? arena + e->off + e->len + 1 : NULL;
+    }
+    return true;
+}
+
+size_t history_len(void) { return ring_count; }
+
+int history_first_id(void) {
+    return ring_count ? entry_at(0)->id : next_id;
+}
+
+int history_next_id(void) { return next_id; }
+
+/* ---------------------------- Registro persistente ---------------------------- */
+
+static const char *idx_suffix = ".idx";
+
+bool history_log_active(void) { return hlog.data_fd != -1; }
+
+const char *history_log_default_path(void) {
+    static char path[4096];
+    const char *env = getenv("P3_HISTFILE");
+    if (env) return *env ? env : NULL;
+    const char *home = getenv("HOME");
+    if (!home || !*home) return NULL;
+    int n = snprintf(path, sizeof path, "%s/%s", home, HISTORY_LOG_NAME);
+    if (n < 0 || (size_t)n >= sizeof path) return NULL;
+    return path;
+}
+
+static void log_unmap(void) {
+    if (hlog.data) munmap((void *)hlog.data, hlog.data_len);
+    if (hlog.idx) munmap((void *)hlog.idx, hlog.idx_map);
+    hlog.data = NULL;
+    hlog.idx = NULL;
+    hlog.data_len = hlog.idx_map = hlog.idx_len = 0;
+}
+
+// Vuelve a proyectar ambos ficheros con su tamaño actual
+static int log_remap(void) {
+    struct stat sd, si;
+    if (fstat(hlog.data_fd, &sd) == -1 || fstat(hlog.idx_fd, &si) == -1)
+        return -1;
+    log_unmap();
+    size_t dlen = (size_t)sd.st_size;
+    size_t icount = (size_t)si.st_size / sizeof(uint64_t);
+    if (dlen) {
+        void *p = mmap(NULL, dlen, PROT_READ, MAP_SHARED, hlog.data_fd, 0);
+        if (p == MAP_FAILED) return -1;
+        hlog.data = p;
+        hlog.data_len = dlen;
+    }
+    if (icount) {
+        void *p = mmap(NULL, icount * sizeof(uint64_t), PROT_READ, MAP_SHARED,
+                       hlog.idx_fd, 0);
+        if (p == MAP_FAILED) { log_unmap(); return -1; }
+        hlog.idx = p;
+        hlog.idx_map = icount * sizeof(uint64_t);
+        hlog.idx_len = icount;
+    }
+    // Un índice por delante de los datos (escritura cortada) se ignora
+    while (hlog.idx_len &&
+           hlog.idx[hlog.idx_len - 1] + sizeof(uint32_t) >= hlog.data_len)
+        hlog.idx_len--;
+    hlog.count = hlog.idx_len;
+    return 0;
+}
+
+// Registro en la posición k de la proyección actual, comprobando límites
+static bool log_read(uint64_t k, int id, tItemH *out) {
+    if (k >= hlog.idx_len) return false;
+    uint64_t off = hlog.idx[k];
+    uint32_t len;
+    if (off > hlog.data_len || hlog.data_len - off < sizeof len) return false;
+    memcpy(&len, hlog.data + off, sizeof len);
+    if ((uint64_t)len + 1 > hlog.data_len - off - sizeof len) return false;
+    if (out) {
+        out->id = id;
+        out->name = hlog.data + off + sizeof len;
+        out->argc = -1;
+        out->args = NULL;
+    }
+    return true;
+}
+
+static bool log_lookup(int id, tItemH *out) {
+    if (!history_log_active() || id < 0) return false;
+    uint64_t k;
+    if ((size_t)id < hlog.base) {
+        k = (uint64_t)id;
+    } else if ((size_t)id - hlog.base < hlog.pos.len) {
+        k = *(uint64_t *)vector_at(&hlog.pos, (size_t)id - hlog.base);
+        if (k == LOG_NONE) return false;
+    } else {
+        return false;
+    }
+    /* Los ficheros pueden haber cambiado de tamaño desde la última
+     * proyección (recortados a mano, incluso): leer fuera daría SIGBUS */
+    struct stat sd, si;
+    if (fstat(hlog.data_fd, &sd) == -1 || fstat(hlog.idx_fd, &si) == -1)
+        return false;
+    if ((size_t)sd.st_size != hlog.data_len ||
+        (size_t)si.st_size / sizeof(uint64_t) * sizeof(uint64_t) !=
+            hlog.idx_map) {
+        if (log_remap() != 0) return false;
+    }
+    return log_read(k, id, out);
+}
+
+// Posición del registro añadido o LOG_NONE
+static uint64_t log_append(const char *line, size_t len) {
+    if (len > UINT32_MAX) return LOG_NONE;
+    uint32_t len32 = (uint32_t)len;
+    struct iovec iov[3] = {
+        { &len32, sizeof len32 },
+        { (void *)line, len },
+        { "", 1 },
+    };
+    size_t total = sizeof len32 + len + 1;
+    uint64_t k = LOG_NONE;
+    // Otro shell puede estar añadiendo: registro e índice bajo el mismo cerrojo
+    flock(hlog.data_fd, LOCK_EX);
+    ssize_t w = writev(hlog.data_fd, iov, 3);
+    off_t end = lseek(hlog.data_fd, 0, SEEK_END);
+    if (w == (ssize_t)total && end != (off_t)-1) {
+        uint64_t off = (uint64_t)end - total;
+        off_t iend;
+        if (write(hlog.idx_fd, &off, sizeof off) == (ssize_t)sizeof off &&
+            (iend = lseek(hlog.idx_fd, 0, SEEK_END)) != (off_t)-1) {
+            k = (uint64_t)iend / sizeof off - 1;
+            hlog.count++;
+        }
+    }
+    flock(hlog.data_fd, LOCK_UN);
+    return k;
+}
+
+// Los ids vuelven a empezar sin ninguna entrada del registro detrás
+static void log_forget(void) {
+    hlog.base = 0;
+    vector_clear(&hlog.pos);
+}
+
+/* Lleva el descriptor lejos de los números bajos: los comandos open, write,
+ * aread... usan los de la numeración habitual (3, 4...) */
+#define LOG_FD_MIN 100
+static int fd_out_of_way(int fd) {
+    if (fd == -1) return -1;
+    int h = fcntl(fd, F_DUPFD_CLOEXEC, LOG_FD_MIN);
+    if (h == -1) return fd;     // sin hueco alto sirve el original
+    close(fd);
+    return h;
+}
+
+int history_log_open(const char *path) {
+    if (!path) { errno = EINVAL; return -1; }
+    history_log_close();
+    size_t plen = strlen(path);
+    char *idx_path = malloc(plen + strlen(idx_suffix) + 1);
+    if (!idx_path) return -1;
+    memcpy(idx_path, path, plen);
+    strcpy(idx_path + plen, idx_suffix);
+    hlog.data_fd = fd_out_of_way(open(path, O_RDWR | O_APPEND | O_CREAT |
+                                           O_CLOEXEC, 0600));
+    hlog.idx_fd = fd_out_of_way(open(idx_path, O_RDWR | O_APPEND | O_CREAT |
+                                     O_CLOEXEC, 0600));
+    free(idx_path);
+    if (hlog.data_fd == -1 || hlog.idx_fd == -1 || log_remap() != 0) {
+        int aux = errno;
+        history_log_close();
+        errno = aux;
+        return -1;
+    }
+    // Los ids de esta sesión siguen a los guardados; el anillo se precarga
+    // con los más recientes sin recorrer el resto del registro
+    if (!ring && history_init(HISTORY_MAX) != 0) return -1;
+    ring_tail = ring_count = arena_wpos = 0;
+    size_t skip = hlog.count > ring_cap ? hlog.count - ring_cap : 0;
+    for (size_t id = skip; id < hlog.count; ++id) {
+        tItemH it;
+        if (!log_read(id, (int)id, &it)) continue;
+        store_entry((int)id, it.name, strlen(it.name));
+    }
+    hlog.base = hlog.count;
+    vector_clear(&hlog.pos);
+    next_id = (int)hlog.count;
+    return 0;
+}
+
+void history_log_close(void) {
+    log_unmap();
+    if (hlog.data_fd != -1) close(hlog.data_fd);
+    if (hlog.idx_fd != -1) close(hlog.idx_fd);
+    hlog.data_fd = hlog.idx_fd = -1;
+    hlog.count = 0;
+    hlog.base = 0;
+    vector_free(&hlog.pos);
+}
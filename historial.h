@@ -0,0 +1,54 @@
+// Pablo Araújo Rodríguez   pablo.araujo@udc.es
+// Uriel Liñares Vaamonde   uriel.linaresv@udc.es
+
+#ifndef HISTORIAL_H
+#define HISTORIAL_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#ifndef HISTORY_MAX
+#define HISTORY_MAX 1000      /* entradas por defecto */
+#endif
+#define HISTORY_ARENA_PER_ENTRY 512
+#define HISTORY_ARENA_MIN (64 * 1024)
+
+typedef struct tItemH{
+    int id;
+    const char *name;   /* apunta a la arena del historial */
+    int argc;           /* -1 si la entrada no se ha troceado */
+    const char *args;   /* argumentos ya troceados, separados por '\0' */
+}tItemH;
+
+/* Historial de tamaño fijo: anillo de entradas cuyo texto vive en una
+ * única arena circular. Registrar un comando no reserva memoria y el
+ * acceso por id es O(1). Al llenarse se descartan las más antiguas. */
+int history_init(size_t max_entries);
+void history_shutdown(void);
+void history_clear(void);
+int history_set_max(size_t max_entries);
+size_t history_max(void);
+
+// Registra una línea; devuelve su id o -1
+int history_add(const char *line);
+// Adjunta a la entrada los argumentos ya troceados para no volver a
+// analizar la línea al repetirla
+int history_set_args(int id, char *const argv[], int argc);
+// Entrada con ese id o false si ya no está en el anillo
+bool history_get(int id, tItemH *out);
+size_t history_len(void);
+int history_first_id(void);
+int history_next_id(void);
+
+/* Registro persistente compartido entre sesiones: fichero de registros
+ * [u32 longitud][texto]['\0'] más un índice de desplazamientos u64, ambos
+ * de solo añadido y proyectados con mmap. Al abrirlo los ids continúan tras
+ * los ya guardados y el anillo se precarga con los últimos. */
+#define HISTORY_LOG_NAME ".p3_history"
+int history_log_open(const char *path);
+void history_log_close(void);
+bool history_log_active(void);
+// Ruta por defecto: $P3_HISTFILE o $HOME/.p3_history (NULL = desactivado)
+const char *history_log_default_path(void);
+
+#endif //HISTORIAL_H
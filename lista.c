@@ -2,6 +2,31 @@
 // Uriel Liñares Vaamonde   uriel.linaresv@udc.es
 
 #include "lista.h"
+#include "contenedores.h"
+
+// Pool común de nodos: una reserva por cada 512 inserciones
+static tPool node_pool;
+static bool node_pool_ready = false;
+
+static Node *alloc_node(void) {
+    if (!node_pool_ready) {
+        pool_init(&node_pool, sizeof(Node), 512);
+        node_pool_ready = true;
+    }
+    return pool_alloc(&node_pool);
+}
+
+// El bloque se conserva aunque se vacíe: se reutiliza hasta list_shutdown
+static void release_node(Node *node) {
+    pool_release(&node_pool, node);
+}
+
+void list_shutdown(void) {
+    // Con nodos vivos (listas sin liberar) el pool sigue haciendo falta
+    if (!node_pool_ready || node_pool.live != 0) return;
+    pool_destroy(&node_pool);
+    node_pool_ready = false;
+}
 
 // Crear lista
 List* createList(void) {
@@ -10,12 +35,15 @@ List* createList(void) {
         fprintf(stderr, "Error: could not create list\n");
         exit(EXIT_FAILURE);
     }
-    list->head = NULL;
+    initList(list);
     return list;
 }
 // Inicializar lista vacía
 void initList(List *list) {
-    if (list) list->head = NULL;
+    if (!list) return;
+    list->head = NULL;
+    list->tail = NULL;
+    list->count = 0;
 }
 
 // Comprobar si la lista está vacía
@@ -27,7 +55,7 @@ bool isEmptyList(List *list) {
 int insertItem(List *list, void *data) {
     if (!list) return 1;
 
-    Node *newNode = malloc(sizeof(Node));
+    Node *newNode = alloc_node();
     if (!newNode) {
         fprintf(stderr, "Error: could not insert item\n");
         exit(EXIT_FAILURE);
@@ -39,8 +67,11 @@ int insertItem(List *list, void *data) {
 
     if (list->head)
         list->head->prev = newNode;
+    else
+        list->tail = newNode;
     newNode->id = 0;
     list->head = newNode;
+    list->count++;
     return 0;
 }
 
@@ -57,42 +88,35 @@ void* findItem(List *list, void *key, int (*cmp)(void*, void*)) {
     return NULL;
 }
 
+// Desenlazar un nodo conocido en O(1)
+void removeNode(List *list, tPos node, void (*destroy)(void*)) {
+    if (!list || !node) return;
+    if (node->prev) node->prev->next = node->next;
+    else list->head = node->next;
+    if (node->next) node->next->prev = node->prev;
+    else list->tail = node->prev;
+    list->count--;
+    if (destroy) destroy(node->data);
+    release_node(node);
+}
+
 // Borrar un elemento (según comparación)
 void deleteItem(List *list, void *key, int (*cmp)(void*, void*),
                 void (*destroy)(void*)) {
     if (!list || !list->head) return;
 
-    Node *current = list->head;
-    Node *prev = NULL;
-
-    while (current) {
+    for (Node *current = list->head; current; current = current->next) {
         if (cmp(current->data, key) == 0) {
-            Node *next = current->next;
-            if (prev == NULL) {
-                list->head = next;
-            } else {
-                prev->next = next;
-            }
-            if (next) next->prev = prev;
-            if (destroy) destroy(current->data);
-            free(current);
+            removeNode(list, current, destroy);
             return;
         }
-        prev = current;
-        current = current->next;
     }
 }
 
 // Eliminar lista completa
 void deleteList(List *list, void (*destroy)(void*)) {
     if (!list) return;
-    Node *current = list->head;
-    while (current) {
-        Node *tmp = current;
-        current = current->next;
-        if (destroy) destroy(tmp->data);
-        free(tmp);
-    }
+    clearList(list, destroy);
     free(list);
 }
 
@@ -107,12 +131,10 @@ void recorrerLista(List *list)
     }
 }
 
+// tPos es el propio nodo: acceso directo sin recorrer la lista
 void *getItem(List *list, tPos pos) {
     if (!list || !pos) return NULL;
-    for (Node *current = list->head; current; current = current->next) {
-        if (current == pos) return current->data;
-    }
-    return NULL;
+    return pos->data;
 }
 
 void * first(List *list)
@@ -123,10 +145,13 @@ void * first(List *list)
 
 void * last(List *list)
 {
-    tPos current = NULL;
     if (!list) return NULL;
-    for (current = list->head; current->next == NULL; current = current->next);
-    return current;
+    return list->tail;
+}
+
+size_t listSize(List *list)
+{
+    return list ? list->count : 0;
 }
 
 void clearList(List *list, void (*destroy)(void*))
@@ -137,7 +162,7 @@ void clearList(List *list, void (*destroy)(void*))
         Node *tmp = current;
         current = current->next;
         if (destroy) destroy(tmp->data);
-        free(tmp);
+        release_node(tmp);
     }
-    list->head = NULL;
+    initList(list);
 }
@@ -17,7 +17,8 @@ typedef struct Node {
     struct Node *prev;
 } Node;
 
-typedef struct { Node *head; } List;
+// Los nodos salen de un pool por bloques compartido por todas las listas
+typedef struct { Node *head; Node *tail; size_t count; } List;
 
 List* createList(void);
 void initList(List *list);
@@ -26,10 +27,14 @@ int insertItem(List *list, void *data);
 void* findItem(List *list, void *key, int (*cmp)(void*, void*));
 void deleteItem(List *list, void *key, int (*cmp)(void*, void*),
                 void (*destroy)(void*));
+void removeNode(List *list, tPos node, void (*destroy)(void*));
 void deleteList(List *list, void (*destroy)(void*));
 void clearList(List *list, void (*destroy)(void*));
 void recorrerLista(List *list);
 void *getItem(List *list, tPos index);
 void * first(List *list);
 void * last(List *list);
+size_t listSize(List *list);
+// Devuelve al sistema los bloques del pool de nodos si ya no queda ninguno
+void list_shutdown(void);
 #endif //LISTA_H
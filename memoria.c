@@ -4,6 +4,9 @@
 #define _POSIX_C_SOURCE 200809L
 
 #include "memoria.h"
+#include "ficheros.h"
+#include "asincrono.h"
+#include "copia.h"
 
 int ext_uninit_a;
 int ext_uninit_b;
@@ -34,6 +37,38 @@ static List *get_mmap_list(void) {
     return &list;
 }
 
+/* Índice único de bloques rastreados ordenado por dirección. Cada rango
+ * guarda su tipo y el nodo de su lista, de modo que validar una región o
+ * liberar por dirección es O(log n) en vez de recorrer las tres listas. */
+enum { BLOCK_MALLOC, BLOCK_SHARED, BLOCK_MMAP };
+
+static tRangeMap *get_block_index(void) {
+    static tRangeMap index;
+    static bool ready = false;
+    if (!ready) { rangemap_init(&index); ready = true; }
+    return &index;
+}
+
+// Registra el nodo recién insertado (cabeza de la lista) en el índice
+static void index_block(List *list, void *addr, size_t size, int kind) {
+    if (rangemap_insert(get_block_index(), (uintptr_t)addr, size, kind,
+                        first(list)) != 0)
+        fprintf(stderr, "Unable to index block %p\n", addr);
+}
+
+static void unindex_block(void *addr) {
+    rangemap_remove(get_block_index(), (uintptr_t)addr);
+}
+
+// Un bloque con E/S asíncrona en curso no se libera (EBUSY)
+static int check_not_busy(void *addr, size_t size) {
+    if (!aio_busy_region(addr, size)) return 0;
+    fprintf(stderr, "Block %p has asynchronous I/O in flight (see aio, await)\n",
+            addr);
+    errno = EBUSY;
+    return -1;
+}
+
 static MmapBlock *find_mmap(void *addr);
 static int perm_to_prot(const char *perm, int *protection);
 static int unmap_mmap_by_path(const char *path);
@@ -52,9 +87,6 @@ static int read_fd(const char *str, int *fd);
 static int read_byte(const char *str, unsigned char *value);
 static bool range_within_block(const void *addr, size_t len,
                                 const void *block_addr, size_t block_size);
-static bool is_region_from_malloc(const void *addr, size_t len);
-static bool is_region_from_shared(const void *addr, size_t len);
-static bool is_region_from_mmap(const void *addr, size_t len);
 static void format_byte_repr(unsigned char byte, char *out, size_t out_len);
 static void recurse_steps(int n);
 static void show_shared(void);
@@ -181,47 +213,12 @@ static bool range_within_block(const void *addr, size_t len,
     return true;
 }
 
-static bool is_region_from_malloc(const void *addr, size_t len) {
-    List *list = get_malloc_list();
-    if (!list || isEmptyList(list)) return false;
-    for (Node *node = list->head; node; node = node->next) {
-        const MallocBlock *block = (const MallocBlock *)node->data;
-        if (!block) continue;
-        if (range_within_block(addr, len, block->addr, block->size))
-            return true;
-    }
-    return false;
-}
-
-static bool is_region_from_shared(const void *addr, size_t len) {
-    List *list = get_shared_list();
-    if (!list || isEmptyList(list)) return false;
-    for (Node *node = list->head; node; node = node->next) {
-        const SharedBlock *block = (const SharedBlock *)node->data;
-        if (!block) continue;
-        if (range_within_block(addr, len, block->addr, block->size))
-            return true;
-    }
-    return false;
-}
-
-static bool is_region_from_mmap(const void *addr, size_t len) {
-    List *list = get_mmap_list();
-    if (!list || isEmptyList(list)) return false;
-    for (Node *node = list->head; node; node = node->next) {
-        const MmapBlock *block = (const MmapBlock *)node->data;
-        if (!block) continue;
-        if (range_within_block(addr, len, block->addr, block->size))
-            return true;
-    }
-    return false;
-}
-
 static int ensure_valid_region(void *addr, size_t len) {
     if (!addr && len == 0) return 0;
-    if (is_region_from_malloc(addr, len)) return 0;
-    if (is_region_from_shared(addr, len)) return 0;
-    if (is_region_from_mmap(addr, len)) return 0;
+    // Los bloques no se solapan: basta con el de mayor inicio <= addr
+    const tRangeNode *r = rangemap_floor(get_block_index(), (uintptr_t)addr);
+    if (r && range_within_block(addr, len, (void *)r->start, r->size))
+        return 0;
     errno = EFAULT;
     return -1;
 }
@@ -292,6 +289,7 @@ static int run_process_map(void) {
         perror(tool);
         return 1;
     }
+    fflush(stdout);  // popen hace fork: vaciamos antes la salida pendiente
     FILE *fp = popen(command, "r");
     if (!fp) { perror(tool); return 1; }
     char line[512];
@@ -345,9 +343,15 @@ static void show_shared(void) {
 static void add_shared(key_t key, size_t size, void *addr, int shmid) {
     SharedBlock *block = find_shared(key);
     if (block) {
+        tRangeNode *r = rangemap_find(get_block_index(),
+                                      (uintptr_t)block->addr);
+        void *node = r ? r->data : NULL;
+        unindex_block(block->addr);
         block->size  = size;
         block->addr  = addr;
         block->shmid = shmid;
+        if (node) rangemap_insert(get_block_index(), (uintptr_t)addr, size,
+                                  BLOCK_SHARED, node);
         return;
     }
     block = (SharedBlock *)malloc(sizeof *block);
@@ -359,16 +363,15 @@ static void add_shared(key_t key, size_t size, void *addr, int shmid) {
     if (insertItem(get_shared_list(), block) != 0) {
         fprintf(stderr, "Unable to register shared block\n");
         free(block);
+        return;
     }
+    index_block(get_shared_list(), addr, size, BLOCK_SHARED);
 }
 
 static MmapBlock *find_mmap(void *addr) {
-    List *list = get_mmap_list();
-    for (Node *node = list->head; node; node = node->next) {
-        MmapBlock *block = (MmapBlock *)node->data;
-        if (block && block->addr == addr) return block;
-    }
-    return NULL;
+    const tRangeNode *r = rangemap_find(get_block_index(), (uintptr_t)addr);
+    if (!r || r->kind != BLOCK_MMAP) return NULL;
+    return (MmapBlock *)getItem(get_mmap_list(), r->data);
 }
 
 static void show_mmap(void) {
@@ -396,6 +399,7 @@ static void add_mmap(const char *path, size_t size, void *addr,
         block->flags      = flags;
         strncpy(block->path, path, sizeof block->path - 1);
         block->path[sizeof block->path - 1] = '\0';
+        rangemap_find(get_block_index(), (uintptr_t)addr)->size = size;
         return;
     }
     block = (MmapBlock *)malloc(sizeof *block);
@@ -410,23 +414,18 @@ static void add_mmap(const char *path, size_t size, void *addr,
     if (insertItem(get_mmap_list(), block) != 0) {
         fprintf(stderr, "Unable to record file mapping\n");
         free(block);
+        return;
     }
+    index_block(get_mmap_list(), addr, size, BLOCK_MMAP);
 }
 
 static int remove_mmap_entry(MmapBlock *block, Node *node, List *list) {
     if (!block || !node || !list) { errno = EINVAL; return -1; }
+    if (check_not_busy(block->addr, block->size) != 0) return -1;
     if (munmap(block->addr, block->size) == -1) { perror("munmap"); return -1; }
-    if (node->prev) node->prev->next = node->next;
-    else list->head = node->next;
-    if (node->next) node->next->prev = node->prev;
-    void *addr = block->addr;
-    char path[PATH_MAX];
-    strncpy(path, block->path, sizeof path - 1);
-    path[sizeof path - 1] = '\0';
-
-    free(block);
-    free(node);
-    printf("Unmapped file %s from %p\n", path, addr);
+    printf("Unmapped file %s from %p\n", block->path, block->addr);
+    unindex_block(block->addr);
+    removeNode(list, node, free);
     return 0;
 }
 
@@ -437,8 +436,7 @@ static int unmap_mmap_by_path(const char *path) {
     for (Node *node = list->head; node; node = node->next) {
         MmapBlock *block = (MmapBlock *)node->data;
         if (!block || strcmp(block->path, path) != 0) continue;
-        remove_mmap_entry(block, node, list);
-        return 0;
+        return remove_mmap_entry(block, node, list);
     }
     errno = ENOENT;
     return -1;
@@ -446,27 +444,20 @@ static int unmap_mmap_by_path(const char *path) {
 
 static int unmap_mmap_by_addr(void *addr) {
     if (!addr) { errno = EINVAL; return -1; }
-    List *list = get_mmap_list();
-    if (!list || isEmptyList(list)) { errno = ENOENT; return -1; }
-    for (Node *node = list->head; node; node = node->next) {
-        MmapBlock *block = (MmapBlock *)node->data;
-        if (!block || block->addr != addr) continue;
-        remove_mmap_entry(block, node, list);
-        return 0;
-    }
-    errno = ENOENT;
-    return -1;
+    const tRangeNode *r = rangemap_find(get_block_index(), (uintptr_t)addr);
+    if (!r || r->kind != BLOCK_MMAP) { errno = ENOENT; return -1; }
+    Node *node = r->data;
+    return remove_mmap_entry(node->data, node, get_mmap_list());
 }
 
-static void detach_shared_entry(SharedBlock *block, Node *node, List *list){
+static int detach_shared_entry(SharedBlock *block, Node *node, List *list){
+    if (check_not_busy(block->addr, block->size) != 0) return -1;
     if (shmdt(block->addr) == -1) perror("shmdt");
-    if (node->prev) node->prev->next = node->next;
-    else list->head = node->next;
-    if (node->next) node->next->prev = node->prev;
     printf("Detached shared memory key %lu at %p\n",
             (unsigned long)block->key, block->addr);
-    free(block);
-    free(node);
+    unindex_block(block->addr);
+    removeNode(list, node, free);
+    return 0;
 }
 
 static int detach_shared_by_key(key_t key) {
@@ -476,8 +467,7 @@ static int detach_shared_by_key(key_t key) {
     for (Node *node = list->head; node; node = node->next) {
         SharedBlock *block = (SharedBlock *)node->data;
         if (!block || block->key != key) continue;
-        detach_shared_entry(block, node, list);
-        return 0;
+        return detach_shared_entry(block, node, list);
     }
 
     errno = ENOENT;
@@ -486,18 +476,10 @@ static int detach_shared_by_key(key_t key) {
 
 static int detach_shared_by_addr(void *addr) {
     if (!addr) { errno = EINVAL; return -1; }
-
-    List *list = get_shared_list();
-    if (!list || isEmptyList(list)) { errno = ENOENT; return -1; }
-
-    for (Node *node = list->head; node; node = node->next) {
-        SharedBlock *block = (SharedBlock *)node->data;
-        if (!block || block->addr != addr) continue;
-        detach_shared_entry(block, node, list);
-        return 0;
-    }
-    errno = ENOENT;
-    return -1;
+    const tRangeNode *r = rangemap_find(get_block_index(), (uintptr_t)addr);
+    if (!r || r->kind != BLOCK_SHARED) { errno = ENOENT; return -1; }
+    Node *node = r->data;
+    return detach_shared_entry(node->data, node, get_shared_list());
 }
 
 static int delete_system_shared(key_t key) {
@@ -573,7 +555,8 @@ int cmd_mmap(int argc, char *argv[]) {
             fprintf(stderr, "Usage: mmap -free file\n"); return 1;
         }
         if (unmap_mmap_by_path(argv[2]) != 0) {
-            fprintf(stderr, "No active mapping found for %s\n", argv[2]);
+            if (errno != EBUSY)
+                fprintf(stderr, "No active mapping found for %s\n", argv[2]);
             return 1;
         }
         return 0;
@@ -626,7 +609,9 @@ int cmd_shared(int argc, char *argv[]) {
         }
         if (strcmp(argv[1], "-free") == 0) {
             if (detach_shared_by_key(clave) != 0) {
-                if (errno == ENOENT) {
+                if (errno == EBUSY) {
+                    // ya avisado
+                } else if (errno == ENOENT) {
                     fprintf(stderr, "No shared memory block found for key %lu\n"
                         ,(unsigned long)clave);
                 } else perror("Unable to detach shared memory");
@@ -678,18 +663,17 @@ static int add_malloc(void *addr, size_t size) {
         free(block);
         return -1;
     }
+    index_block(get_malloc_list(), addr, size, BLOCK_MALLOC);
     return 0;
 }
 
-static void release_malloc_entry(MallocBlock *block, Node *node, List *list){
-    if (node->prev) node->prev->next = node->next;
-    else list->head = node->next;
-    if (node->next) node->next->prev = node->prev;
+static int release_malloc_entry(MallocBlock *block, Node *node, List *list){
+    if (check_not_busy(block->addr, block->size) != 0) return -1;
     printf("Liberado bloque malloc de %zu bytes en %p\n",
             block->size, block->addr);
-    free(block->addr);
-    free(block);
-    free(node);
+    unindex_block(block->addr);
+    removeNode(list, node, destroy_malloc_block);
+    return 0;
 }
 
 static int free_malloc_by_size(size_t size) {
@@ -698,24 +682,18 @@ static int free_malloc_by_size(size_t size) {
     for (Node *node = list->head; node; node = node->next) {
         MallocBlock *block = (MallocBlock *)node->data;
         if (!block || block->size != size) continue;
-        release_malloc_entry(block, node, list);
-        return 0;
+        return release_malloc_entry(block, node, list);
     }
+    errno = ENOENT;
     return -1;
 }
 
 static int free_malloc_by_addr(void *addr) {
     if (!addr) { errno = EINVAL; return -1; }
-    List *list = get_malloc_list();
-    if (!list || isEmptyList(list)) { errno = ENOENT; return -1; }
-    for (Node *node = list->head; node; node = node->next) {
-        MallocBlock *block = (MallocBlock *)node->data;
-        if (!block || block->addr != addr) continue;
-        release_malloc_entry(block, node, list);
-        return 0;
-    }
-    errno = ENOENT;
-    return -1;
+    const tRangeNode *r = rangemap_find(get_block_index(), (uintptr_t)addr);
+    if (!r || r->kind != BLOCK_MALLOC) { errno = ENOENT; return -1; }
+    Node *node = r->data;
+    return release_malloc_entry(node->data, node, get_malloc_list());
 }
 
 int cmd_malloc(int argc, char *argv[]) {
@@ -744,7 +722,8 @@ int cmd_malloc(int argc, char *argv[]) {
     if (req == 0) { puts("Cannot allocate 0 bytes"); return 1; }
     if (free_flag) {
         if (free_malloc_by_size(req) != 0) {
-            fprintf(stderr, "No malloc block of %zu bytes found\n", req);
+            if (errno != EBUSY)
+                fprintf(stderr, "No malloc block of %zu bytes found\n", req);
             return 1;
         }
         return 0;
@@ -764,8 +743,11 @@ int cmd_free(int argc, char *argv[]) {
     void *addr = parse_pointer(argv[1]);
     if (!addr) { perror("parse_pointer"); return 1; }
     if (free_malloc_by_addr(addr) == 0) { return 0; }
+    if (errno == EBUSY) return 1;
     if (detach_shared_by_addr(addr) == 0) { return 0; }
+    if (errno == EBUSY) return 1;
     if (unmap_mmap_by_addr(addr) == 0) { return 0; }
+    if (errno == EBUSY) return 1;
     fprintf(stderr, "No block found for %p\n", addr);
     return 1;
 }
@@ -843,6 +825,7 @@ void mem_cleanup(void) {
     clearList(get_mmap_list(), destroy_mmap_block);
     clearList(get_shared_list(), destroy_shared_block);
     clearList(get_malloc_list(), destroy_malloc_block);
+    rangemap_free(get_block_index());
 }
 
 int cmd_memfill(int argc, char *argv[]) {
@@ -890,38 +873,39 @@ static void recurse_steps(int n)
     if (n - 1 > 0) { recurse_steps(n - 1); }
 }
 
-static ssize_t read_file_chunk(char *f, void *p, size_t cont)
+/* Lee el fichero entero (o cont bytes) en p. Se abre antes de mirar el
+ * tamaño, así que ambos son del mismo fichero; -1 como cont lo lee entero.
+ * Bytes leídos o -1 con errno */
+static long long read_file_chunk(const char *f, void *p, size_t cont,
+                                 bool *direct)
 {
     struct stat s;
-    ssize_t  n;
-    int df,aux;
-    if (stat (f,&s)==-1 || (df=open(f,O_RDONLY))==-1) return -1;
-    if (cont == (size_t)-1) {  /* si pasamos -1 como bytes a leer lo leemos entero*/
-        if (s.st_size < 0) {
-            close(df);
-            errno = EINVAL;
-            return -1;
-        }
+    int df = open(f, O_RDONLY | O_CLOEXEC);
+    if (df == -1) return -1;
+    if (fstat(df, &s) == -1) goto fail;
+    if (cont == (size_t)-1) {
+        // Tuberías y dispositivos no tienen tamaño: hay que dar count
+        if (!S_ISREG(s.st_mode)) { errno = EINVAL; goto fail; }
         cont = (size_t)s.st_size;
     }
-    if (ensure_valid_region(p, cont) != 0) {
-        close(df);
-        errno = EFAULT;
-        return -1;
-    }
-    if ((n=read(df,p,cont))==-1){
-        aux = errno;
-        close(df);
-        errno = aux;
-        return -1;
-    }
-    close (df);
+    if (ensure_valid_region(p, cont) != 0) goto fail;
+    long long n = copia_a_memoria(df, p, cont, direct);
+    if (n == -1) goto fail;
+    close(df);
     return n;
+fail:;
+    int aux = errno;
+    close(df);
+    errno = aux;
+    return -1;
 }
 
 int cmd_readfile(int argc, char *argv[]){
+    bool direct = argc > 1 && strcmp(argv[1], "-direct") == 0;
+    if (direct) { argc--; argv++; }
     if (argc != 3 && argc != 4) {
-        fprintf(stderr, "Usage: readfile file addr [count]\n"); return 1;
+        fprintf(stderr, "Usage: readfile [-direct] file addr [count]\n");
+        return 1;
     }
     void *addr = parse_pointer(argv[2]);
     if (!addr) { perror("parse_pointer"); return 1; }
@@ -931,9 +915,21 @@ int cmd_readfile(int argc, char *argv[]){
             fprintf(stderr, "Invalid count: %s\n", argv[3]); return 1;
         }
     }
-    ssize_t n = read_file_chunk(argv[1], addr, cont);
+    bool asked = direct;
+    struct timespec t0, t1;
+    clock_gettime(CLOCK_MONOTONIC, &t0);
+    long long n = read_file_chunk(argv[1], addr, cont, &direct);
+    clock_gettime(CLOCK_MONOTONIC, &t1);
+    if (n == -1 && errno == EINVAL && cont == (size_t)-1) {
+        fprintf(stderr, "readfile: %s: count required\n", argv[1]);
+        return 1;
+    }
     if (n == -1) { perror("Unable to read file"); return 1; }
-    printf("Read %lld bytes from %s into %p\n", (long long)n, argv[1], addr);
+    double ms = (double)(t1.tv_sec - t0.tv_sec) * 1e3 +
+                (double)(t1.tv_nsec - t0.tv_nsec) / 1e6;
+    printf("Read %lld bytes from %s into %p in %.3f ms (%.1f MB/s%s)\n", n,
+           argv[1], addr, ms, ms > 0 ? (double)n / (ms * 1e3) : 0.0,
+           direct ? ", direct" : asked ? ", O_DIRECT unsupported" : "");
     return 0;
 }
 
@@ -956,6 +952,8 @@ int cmd_read(int argc, char *argv[]){
                 addr, count);
         return 1;
     }
+    // Lo escrito con buffer tiene que estar en el fichero antes de leer
+    if (ficheros_flush(fd) != 0) { perror("flush"); return 1; }
     ssize_t n = read(fd, addr, count);
     if (n == -1) { perror("read"); return 1; }
 
@@ -1022,13 +1020,99 @@ int cmd_write(int argc, char *argv[]){
                 addr, count);
         return 1;
     }
-    ssize_t written = write(fd, addr, count);
+    ssize_t written = ficheros_write(fd, addr, count);
     if (written == -1) { perror("write"); return 1; }
     printf("%lld bytes written to descriptor %d from %p\n",
             (long long)written, fd, addr);
     return 0;
 }
 
+/* Variantes asíncronas: validan igual que read, write y readfile, encolan
+ * la operación y devuelven su identificador sin esperar (ver await, aio) */
+static int submit_async(aio_op_t op, int fd, bool own_fd, bool full,
+                        void *addr, size_t count, long long off,
+                        const char *desc) {
+    int id = aio_submit(op, fd, own_fd, full, addr, count, off, desc);
+    if (id == -1) { perror("aio_submit"); return 1; }
+    printf("[%d] %s: submitted\n", id, desc);
+    return 0;
+}
+
+static int cmd_async_fd(int argc, char *argv[], aio_op_t op) {
+    const char *name = op == AIO_READ ? "aread" : "awrite";
+    if (argc != 4) {
+        fprintf(stderr, "Usage: %s fd addr count\n", name); return 1;
+    }
+    int fd = 0;
+    if (read_fd(argv[1], &fd) != 0) {
+        fprintf(stderr, "Invalid descriptor: %s\n", argv[1]); return 1;
+    }
+    void *addr = parse_pointer(argv[2]);
+    if (!addr) { perror("parse_pointer"); return 1; }
+    size_t count = 0;
+    if (read_size(argv[3], &count) != 0) {
+        fprintf(stderr, "Invalid count: %s\n", argv[3]); return 1;
+    }
+    if (ensure_valid_region(addr, count) != 0) {
+        fprintf(stderr, "%s: invalid address %p (%zu bytes)\n", name,
+                addr, count);
+        return 1;
+    }
+    // Lo pendiente en el buffer de escritura va antes que la petición
+    if (ficheros_flush(fd) != 0) { perror("flush"); return 1; }
+    char desc[96];
+    snprintf(desc, sizeof desc, "%s %d %p %zu", name, fd, addr, count);
+    return submit_async(op, fd, false, false, addr, count, -1, desc);
+}
+
+int cmd_aread(int argc, char *argv[]){
+    return cmd_async_fd(argc, argv, AIO_READ);
+}
+
+int cmd_awrite(int argc, char *argv[]){
+    return cmd_async_fd(argc, argv, AIO_WRITE);
+}
+
+int cmd_areadfile(int argc, char *argv[]){
+    if (argc != 3 && argc != 4) {
+        fprintf(stderr, "Usage: areadfile file addr [count]\n"); return 1;
+    }
+    void *addr = parse_pointer(argv[2]);
+    if (!addr) { perror("parse_pointer"); return 1; }
+    size_t cont = (size_t)-1;
+    if (argc == 4 && read_size(argv[3], &cont) != 0) {
+        fprintf(stderr, "Invalid count: %s\n", argv[3]); return 1;
+    }
+    int df = open(argv[1], O_RDONLY | O_CLOEXEC);
+    struct stat s;
+    if (df == -1 || fstat(df, &s) == -1) {
+        perror("Unable to read file");
+        if (df != -1) close(df);
+        return 1;
+    }
+    if (cont == (size_t)-1) {
+        // Como en readfile: sin tamaño que leer hay que dar count
+        if (!S_ISREG(s.st_mode)) {
+            fprintf(stderr, "areadfile: %s: count required\n", argv[1]);
+            close(df);
+            return 1;
+        }
+        cont = (size_t)s.st_size;
+    }
+    if (ensure_valid_region(addr, cont) != 0) {
+        fprintf(stderr, "areadfile: invalid address %p (%zu bytes)\n",
+                addr, cont);
+        close(df);
+        return 1;
+    }
+    char desc[PATH_MAX + 64];
+    snprintf(desc, sizeof desc, "areadfile %s %p %zu", argv[1], addr, cont);
+    // El descriptor pasa a la petición, que lo cierra al terminar
+    int rc = submit_async(AIO_READ, df, true, true, addr, cont, 0, desc);
+    if (rc != 0) close(df);
+    return rc;
+}
+
 int cmd_mem(int argc, char *argv[]) {
     if (argc != 2) {
         fprintf(stderr, "Usage: mem [-funcs|-vars|-blocks|-all|-pmap]\n");
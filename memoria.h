@@ -24,6 +24,7 @@
 
 #include "p3.h"
 #include "lista.h"
+#include "contenedores.h"
 
 #ifndef PATH_MAX
 #define PATH_MAX 4096
@@ -68,6 +69,9 @@ int cmd_read(int argc, char *argv[]);
 int cmd_readfile(int argc, char *argv[]);
 int cmd_write(int argc, char *argv[]);
 int cmd_writefile(int argc, char *argv[]);
+int cmd_aread(int argc, char *argv[]);
+int cmd_awrite(int argc, char *argv[]);
+int cmd_areadfile(int argc, char *argv[]);
 int cmd_mem(int argc, char *argv[]);
 void mem_cleanup(void);
 
@@ -0,0 +1,378 @@
+// Pablo Araújo Rodríguez   pablo.araujo@udc.es
+// Uriel Liñares Vaamonde   uriel.linaresv@udc.es
+
+#define _GNU_SOURCE
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#ifdef __linux__
+#include <sys/sysmacros.h>
+#endif
+#include "metadatos.h"
+#include "hilos.h"
+#include "uring.h"
+
+#ifdef STATX_BASIC_STATS
+#define HAVE_STATX 1
+#else
+#define HAVE_STATX 0
+#endif
+
+#define URING_ENTRIES 256   // SQE por anillo: statx por llamada al sistema
+#define URING_MIN 16        // por debajo no compensa el anillo
+#define POOL_MIN 1024       // lotes menores no se reparten entre hilos
+#define POOL_CHUNK 256
+
+/* ---------------------------- Consulta síncrona ---------------------------- */
+
+static void from_stat(const struct stat *sb, tMeta *m) {
+    m->size = sb->st_size;
+    m->blocks = sb->st_blocks;
+    m->mtime = sb->st_mtime;
+    m->mode = sb->st_mode;
+    m->uid = sb->st_uid;
+    m->gid = sb->st_gid;
+    m->nlink = sb->st_nlink;
+    m->ino = sb->st_ino;
+    m->dev = sb->st_dev;
+}
+
+#if HAVE_STATX
+// El kernel o un filtro seccomp pueden no tener statx: pasamos a fstatat
+static atomic_bool statx_missing;
+
+static unsigned statx_mask(unsigned need) {
+    unsigned mask = STATX_TYPE;
+    if (need & META_SIZE) mask |= STATX_SIZE;
+    if (need & META_MTIME) mask |= STATX_MTIME;
+    if (need & META_PERMS) mask |= STATX_MODE;
+    if (need & META_OWNER) mask |= STATX_UID | STATX_GID;
+    if (need & META_NLINK) mask |= STATX_NLINK;
+    if (need & META_INO) mask |= STATX_INO;
+    if (need & META_BLOCKS) mask |= STATX_BLOCKS;
+    return mask;
+}
+
+static void from_statx(const struct statx *sx, tMeta *m) {
+    m->size = (off_t)sx->stx_size;
+    m->blocks = (blkcnt_t)sx->stx_blocks;
+    m->mtime = (time_t)sx->stx_mtime.tv_sec;
+    m->mode = (mode_t)sx->stx_mode;
+    m->uid = (uid_t)sx->stx_uid;
+    m->gid = (gid_t)sx->stx_gid;
+    m->nlink = (nlink_t)sx->stx_nlink;
+    m->ino = (ino_t)sx->stx_ino;
+    m->dev = makedev(sx->stx_dev_major, sx->stx_dev_minor);
+}
+#endif
+
+int meta_one(int dfd, const char *name, unsigned need, tMeta *out) {
+#if HAVE_STATX
+    if (!atomic_load_explicit(&statx_missing, memory_order_relaxed)) {
+        struct statx sx;
+        if (statx(dfd, name, AT_SYMLINK_NOFOLLOW | AT_STATX_SYNC_AS_STAT,
+                  statx_mask(need), &sx) == 0) {
+            from_statx(&sx, out);
+            return 0;
+        }
+        if (errno != ENOSYS) return -1;
+        atomic_store(&statx_missing, true);
+    }
+#else
+    (void)need;
+#endif
+    struct stat sb;
+    if (fstatat(dfd, name, &sb, AT_SYMLINK_NOFOLLOW) != 0) return -1;
+    from_stat(&sb, out);
+    return 0;
+}
+
+static void batch_sync(int dfd, const char *const *names, size_t lo,
+                       size_t hi, unsigned need, tMeta *out, int *errs) {
+    for (size_t i = lo; i < hi; ++i)
+        errs[i] = meta_one(dfd, names[i], need, &out[i]) == 0 ? 0 : errno;
+}
+
+/* ---------------------------- io_uring ---------------------------- */
+
+#if URING_AVAILABLE && HAVE_STATX
+/* Un anillo por hilo, creado en el primer lote grande y liberado al
+ * terminar el hilo. Cada operación en vuelo ocupa un hueco con su buffer
+ * statx; user_data es el número de hueco. */
+typedef struct {
+    tUring ring;
+    struct statx bufs[URING_ENTRIES];
+    size_t slot_idx[URING_ENTRIES];     // entrada del lote en cada hueco
+    unsigned free_slots[URING_ENTRIES];
+} tMetaRing;
+
+static pthread_key_t ring_key;
+static pthread_once_t ring_once = PTHREAD_ONCE_INIT;
+static atomic_bool uring_broken;        // el kernel no da IORING_OP_STATX
+static _Thread_local tMetaRing *tl_ring;
+static _Thread_local bool tl_ring_failed;
+
+static void ring_destroy(void *p) {
+    tMetaRing *r = p;
+    if (!r) return;
+    uring_free(&r->ring);
+    free(r);
+}
+
+static void ring_key_init(void) {
+    pthread_key_create(&ring_key, ring_destroy);
+}
+
+static tMetaRing *thread_ring(void) {
+    if (tl_ring) return tl_ring;
+    if (tl_ring_failed || atomic_load(&uring_broken)) return NULL;
+    tl_ring_failed = true;
+    pthread_once(&ring_once, ring_key_init);
+    tMetaRing *r = malloc(sizeof *r);
+    if (!r) return NULL;
+    if (uring_init(&r->ring, URING_ENTRIES) != 0) {
+        // Sin soporte en el kernel no lo volverá a intentar ningún hilo
+        if (errno == ENOSYS || errno == EPERM) atomic_store(&uring_broken, true);
+        free(r);
+        return NULL;
+    }
+    if (pthread_setspecific(ring_key, r) != 0) {
+        ring_destroy(r);
+        return NULL;
+    }
+    tl_ring_failed = false;
+    tl_ring = r;
+    return r;
+}
+
+static void ring_prep_statx(struct io_uring_sqe *sqe, int dfd,
+                            const char *name, unsigned mask,
+                            struct statx *buf, unsigned slot) {
+    sqe->opcode = IORING_OP_STATX;
+    sqe->fd = dfd;
+    sqe->addr = (unsigned long long)(uintptr_t)name;
+    sqe->len = mask;
+    sqe->off = (unsigned long long)(uintptr_t)buf;
+    sqe->statx_flags = AT_SYMLINK_NOFOLLOW | AT_STATX_SYNC_AS_STAT;
+    sqe->user_data = slot;
+}
+
+// Devuelve false si el anillo falla; lo pendiente lo resuelve quien llama
+static bool batch_uring(tMetaRing *r, int dfd, const char *const *names,
+                        size_t n, unsigned need, tMeta *out, int *errs,
+                        bool *done) {
+    unsigned mask = statx_mask(need), nfree = URING_ENTRIES, inflight = 0;
+    for (unsigned s = 0; s < URING_ENTRIES; ++s)
+        r->free_slots[s] = URING_ENTRIES - 1 - s;
+    size_t next = 0;
+    bool ok = true;
+    while (next < n || inflight > 0) {
+        while (next < n && nfree > 0) {
+            struct io_uring_sqe *sqe = uring_get_sqe(&r->ring);
+            if (!sqe) break;
+            unsigned slot = r->free_slots[--nfree];
+            r->slot_idx[slot] = next;
+            ring_prep_statx(sqe, dfd, names[next], mask, &r->bufs[slot], slot);
+            ++next;
+            ++inflight;
+        }
+        if (uring_submit(&r->ring, 1) < 0) {
+            if (errno == EAGAIN || errno == EBUSY) continue;
+            ok = false;
+            break;
+        }
+        struct io_uring_cqe *cqe;
+        while ((cqe = uring_peek_cqe(&r->ring))) {
+            unsigned slot = (unsigned)cqe->user_data;
+            int res = cqe->res;
+            uring_cqe_seen(&r->ring);
+            size_t i = r->slot_idx[slot];
+            r->free_slots[nfree++] = slot;
+            --inflight;
+            // Kernel sin IORING_OP_STATX: la entrada se repite en síncrono
+            if (res == -EINVAL) { atomic_store(&uring_broken, true); continue; }
+            errs[i] = -res;
+            if (res == 0) from_statx(&r->bufs[slot], &out[i]);
+            done[i] = true;
+        }
+    }
+    if (!ok) {
+        // Con operaciones en vuelo el anillo ya no es reutilizable
+        tl_ring = NULL;
+        tl_ring_failed = true;
+    }
+    return ok && !atomic_load(&uring_broken);
+}
+
+static bool try_uring(int dfd, const char *const *names, size_t n,
+                      unsigned need, tMeta *out, int *errs) {
+    tMetaRing *r = thread_ring();
+    if (!r) return false;
+    bool *done = calloc(n, sizeof *done);
+    if (!done) return false;
+    if (!batch_uring(r, dfd, names, n, need, out, errs, done)) {
+        for (size_t i = 0; i < n; ++i)
+            if (!done[i]) batch_sync(dfd, names, i, i + 1, need, out, errs);
+    }
+    free(done);
+    return true;
+}
+
+static void uring_thread_free(void) {
+    if (!tl_ring) return;
+    pthread_setspecific(ring_key, NULL);
+    ring_destroy(tl_ring);
+    tl_ring = NULL;
+}
+#else
+static bool try_uring(int dfd, const char *const *names, size_t n,
+                      unsigned need, tMeta *out, int *errs) {
+    (void)dfd; (void)names; (void)n; (void)need; (void)out; (void)errs;
+    return false;
+}
+
+static void uring_thread_free(void) {}
+#endif
+
+/* ---------------------------- Grupo de hilos ---------------------------- */
+
+typedef struct {
+    int dfd;
+    const char *const *names;
+    unsigned need;
+    tMeta *out;
+    int *errs;
+    size_t left;                // trozos sin terminar
+    pthread_mutex_t lock;
+    pthread_cond_t done_cv;
+} tPoolJob;
+
+typedef struct {
+    tPoolJob *job;
+    size_t lo, hi;
+} tPoolChunk;
+
+// sysconf() lee /sys en cada llamada; basta con consultarlo una vez
+static int cpus(void) {
+    static atomic_int cached;
+    int n = atomic_load_explicit(&cached, memory_order_relaxed);
+    if (n == 0) {
+        n = hilos_online();
+        atomic_store_explicit(&cached, n, memory_order_relaxed);
+    }
+    return n;
+}
+
+static pthread_mutex_t pool_lock = PTHREAD_MUTEX_INITIALIZER;
+static tExecutor *pool;
+
+static tExecutor *get_pool(bool forced) {
+    int workers = cpus() - 1;
+    if (workers < 1) {
+        if (!forced) return NULL;
+        workers = 1;
+    }
+    pthread_mutex_lock(&pool_lock);
+    if (!pool) pool = executor_create(workers);
+    tExecutor *ex = pool;
+    pthread_mutex_unlock(&pool_lock);
+    return ex;
+}
+
+static void chunk_done(tPoolJob *job) {
+    pthread_mutex_lock(&job->lock);
+    if (--job->left == 0) pthread_cond_signal(&job->done_cv);
+    pthread_mutex_unlock(&job->lock);
+}
+
+static void chunk_task(void *arg) {
+    tPoolChunk *c = arg;
+    tPoolJob *j = c->job;
+    batch_sync(j->dfd, j->names, c->lo, c->hi, j->need, j->out, j->errs);
+    chunk_done(j);
+}
+
+static bool try_pool(int dfd, const char *const *names, size_t n,
+                     unsigned need, tMeta *out, int *errs, bool forced) {
+    tExecutor *ex = get_pool(forced);
+    if (!ex) return false;
+    size_t nchunks = (n + POOL_CHUNK - 1) / POOL_CHUNK;
+    tPoolChunk *chunks = malloc(nchunks * sizeof *chunks);
+    if (!chunks) return false;
+    tPoolJob job = { dfd, names, need, out, errs, nchunks,
+                     PTHREAD_MUTEX_INITIALIZER, PTHREAD_COND_INITIALIZER };
+    for (size_t c = 0; c < nchunks; ++c) {
+        chunks[c].job = &job;
+        chunks[c].lo = c * POOL_CHUNK;
+        chunks[c].hi = c + 1 == nchunks ? n : (c + 1) * POOL_CHUNK;
+    }
+    // El primer trozo lo hace quien llama mientras los demás se reparten
+    for (size_t c = 1; c < nchunks; ++c)
+        if (executor_submit(ex, chunk_task, &chunks[c]) != 0)
+            chunk_task(&chunks[c]);
+    chunk_task(&chunks[0]);
+    pthread_mutex_lock(&job.lock);
+    while (job.left > 0) pthread_cond_wait(&job.done_cv, &job.lock);
+    pthread_mutex_unlock(&job.lock);
+    pthread_mutex_destroy(&job.lock);
+    pthread_cond_destroy(&job.done_cv);
+    free(chunks);
+    return true;
+}
+
+/* ---------------------------- Interfaz ---------------------------- */
+
+
+void meta_batch(int dfd, const char *const *names, size_t n, unsigned need,
+                meta_backend_t backend, tMeta *out, int *errs) {
+    if (n == 0) return;
+    switch (backend) {
+    case META_AUTO:
+        /* El kernel hace los statx del anillo en sus hilos io-wq: con una
+         * sola CPU y la caché caliente solo añade coste */
+        if (cpus() < 2) break;
+        if (n >= URING_MIN && try_uring(dfd, names, n, need, out, errs)) return;
+        if (n >= POOL_MIN &&
+            try_pool(dfd, names, n, need, out, errs, false)) return;
+        break;
+    case META_URING:
+        if (try_uring(dfd, names, n, need, out, errs)) return;
+        break;
+    case META_THREADS:
+        if (try_pool(dfd, names, n, need, out, errs, true)) return;
+        break;
+    case META_SYNC:
+        break;
+    }
+    batch_sync(dfd, names, 0, n, need, out, errs);
+}
+
+static const char *const backend_names[] = { "auto", "uring", "threads", "sync" };
+
+const char *meta_backend_name(meta_backend_t b) {
+    return backend_names[b];
+}
+
+int meta_backend_parse(const char *name, meta_backend_t *out) {
+    for (size_t i = 0; i < sizeof backend_names / sizeof *backend_names; ++i) {
+        if (strcmp(name, backend_names[i]) == 0) {
+            *out = (meta_backend_t)i;
+            return 0;
+        }
+    }
+    return -1;
+}
+
+void meta_shutdown(void) {
+    uring_thread_free();
+    pthread_mutex_lock(&pool_lock);
+    executor_destroy(pool);
+    pool = NULL;
+    pthread_mutex_unlock(&pool_lock);
+}
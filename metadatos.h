@@ -0,0 +1,52 @@
+// Pablo Araújo Rodríguez   pablo.araujo@udc.es
+// Uriel Liñares Vaamonde   uriel.linaresv@udc.es
+
+#ifndef METADATOS_H
+#define METADATOS_H
+
+#include <stddef.h>
+#include <sys/types.h>
+
+/* Metadatos de entradas de directorio por lotes. Se piden con statx()
+ * solo los campos necesarios y, con muchas entradas, se encolan en un
+ * anillo io_uring por hilo (cientos de statx por llamada al sistema). Sin
+ * io_uring, los lotes grandes se reparten entre un grupo de hilos; si no,
+ * se consultan en secuencia. Nunca se siguen los enlaces simbólicos. */
+
+typedef struct {
+    off_t size;
+    blkcnt_t blocks;        // de 512 bytes
+    time_t mtime;
+    mode_t mode;
+    uid_t uid;
+    gid_t gid;
+    nlink_t nlink;
+    ino_t ino;
+    dev_t dev;
+} tMeta;
+
+// Campos pedidos (el tipo de fichero siempre viene)
+#define META_SIZE   0x01u
+#define META_MTIME  0x02u
+#define META_PERMS  0x04u
+#define META_OWNER  0x08u
+#define META_NLINK  0x10u
+#define META_INO    0x20u
+#define META_BLOCKS 0x40u
+
+typedef enum { META_AUTO, META_URING, META_THREADS, META_SYNC } meta_backend_t;
+
+// Rellena out[i] para dfd/names[i]; errs[i] queda a 0 o con el errno
+void meta_batch(int dfd, const char *const *names, size_t n, unsigned need,
+                meta_backend_t backend, tMeta *out, int *errs);
+// Una sola entrada; 0 o -1 con errno
+int meta_one(int dfd, const char *name, unsigned need, tMeta *out);
+
+const char *meta_backend_name(meta_backend_t b);
+// -1 si name no es auto|uring|threads|sync
+int meta_backend_parse(const char *name, meta_backend_t *out);
+
+// Libera el anillo del hilo actual y el grupo de hilos
+void meta_shutdown(void);
+
+#endif //METADATOS_H
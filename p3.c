@@ -5,18 +5,21 @@
 #include <stdlib.h>
 #include <signal.h>
 #include <errno.h>
+#include <fcntl.h>
 #include "p3.h"
 #include "comandos.h"
 #include "ficheros.h"
+#include "asincrono.h"
 
 static char **g_envp = NULL;
 static bool shell_should_exit = false;
 static char *command_buffer = NULL;
 static bool cleanup_done = false;
 static volatile sig_atomic_t sigint_received = 0;
-static List *env_owned_buffers = NULL;
+// Buffers de entorno reservados por el shell (conjunto por dirección)
+static tHashMap env_owned_buffers;
+static bool env_owned_ready = false;
 static void shell_cleanup(void);
-static void handle_sigint(int sig);
 
 void print_logo(void) {
     printf("\n");
@@ -45,29 +48,49 @@ void shell_set_envp(char **envp) {
 static void shell_cleanup(void) {
     if (cleanup_done) return;
     cleanup_done = true;
-    if (env_owned_buffers) {
-        deleteList(env_owned_buffers, free);
-        env_owned_buffers = NULL;
+    if (env_owned_ready) {
+        size_t it = 0;
+        for (tHashSlot *s; (s = hashmap_next(&env_owned_buffers, &it));)
+            free(s->value);
+        hashmap_free(&env_owned_buffers);
+        env_owned_ready = false;
     }
     commands_shutdown();
-    ficheros_shutdown();
+    /* Antes que los ficheros y bloques sobre los que aún haya peticiones.
+     * Si alguna no ha terminado, el kernel o un hilo sigue usando su bloque
+     * y su descriptor: solo se vuelcan los buffers y se deja todo al salir */
+    bool idle = aio_shutdown();
+    if (idle) ficheros_shutdown();
+    else ficheros_flush_all();
     procesos_destroy();
-    mem_cleanup();
+    if (idle) {
+        mem_cleanup();
+        list_shutdown();
+    }
     free(command_buffer);
     command_buffer = NULL;
 }
 
+#ifndef P3_NO_MAIN
 static void handle_sigint(int sig) {
     (void)sig;
     sigint_received = 1;
+    aio_interrupt();
     ssize_t unused = write(STDOUT_FILENO, "\n", 1);
     (void)unused;
 }
 
+static void usage(const char *prog) {
+    fprintf(stderr, "Usage: %s [-f script | -c \"cmd; cmd ...\"]\n", prog);
+}
+
 int main(int argc, char *argv[], char *envp[])
 {
-    (void)argc;
-    (void)argv;
+    const char *script = NULL;
+    const char *inline_cmds = NULL;
+    if (argc == 3 && strcmp(argv[1], "-f") == 0) script = argv[2];
+    else if (argc == 3 && strcmp(argv[1], "-c") == 0) inline_cmds = argv[2];
+    else if (argc != 1) { usage(argv[0]); return 2; }
     atexit(shell_cleanup);
     struct sigaction sa;
     memset(&sa, 0, sizeof(sa));
@@ -75,10 +98,12 @@ int main(int argc, char *argv[], char *envp[])
     sigemptyset(&sa.sa_mask);
     sigaction(SIGINT, &sa, NULL);
     shell_set_envp(envp);
+    if (script || inline_cmds) return loop_script(script, inline_cmds);
     print_logo();
     loop(envp);
     return 0;
 }
+#endif
 
 void prompt()
 {
@@ -88,7 +113,7 @@ void prompt()
 void loop(char *env[]) {
     (void)env;
     shell_should_exit = false;
-    commands_init();
+    commands_init(true);
     ficheros_init();
     procesos_init();
 
@@ -99,28 +124,175 @@ void loop(char *env[]) {
         return;
     }
     command_buffer = command;
+    tArgs args;
+    args_init(&args);
 
     while (!shell_should_exit) {
         prompt();
-        char *tempCommand = readCommand(command, true);
+        char *tempCommand = readCommand(command, true, &args);
         if (tempCommand != NULL) {
             if (tempCommand != command) {
                 free(command);
                 command = tempCommand;
                 command_buffer = command;
             }
-            char *argv[MAX_TR] = {0};
-            const int argc = chopString(command, argv);
-            processCommand(argc, argv);
+            processCommand(args.argc, args.argv);
         } else {
             perror("Error reading command");
             shell_should_exit = true;
         }
     }
+    args_free(&args);
     printf("Goodbye :3\n");
     shell_cleanup();
 }
 
+/* ---------------------------- Modo script ---------------------------- */
+
+#define SCRIPT_CHUNK (64 * 1024)
+
+typedef struct {
+    unsigned long run;
+    unsigned long failed;
+} tScriptStats;
+
+// Ejecuta un comando ya delimitado (se ignoran vacíos y comentarios)
+static void script_run_one(char *cmd, tArgs *args, tScriptStats *st) {
+    cmd += strspn(cmd, " \t\r");
+    if (*cmd == '\0' || *cmd == '#') return;
+    readCommand(cmd, false, args);
+    if (args->argc == 0) return;
+    st->run++;
+    if (processCommand(args->argc, args->argv) != 0) st->failed++;
+}
+
+/* Parte buf[0..len) en comandos separados por '\n' o ';' fuera de comillas
+ * y ejecuta los completos. *scan y *quote conservan el estado del análisis
+ * entre bloques; devuelve cuántos bytes se han consumido. */
+static size_t script_feed(char *buf, size_t len, size_t *scan, char *quote,
+                          bool final, tArgs *args, tScriptStats *st) {
+    size_t start = 0;
+    size_t i = *scan;
+    for (; i < len && !shell_should_exit; ++i) {
+        char c = buf[i];
+        if (*quote) {
+            if (c == *quote) *quote = 0;
+            else if (*quote == '"' && c == '\\') {
+                if (i + 1 >= len && !final) break;  // igual que fuera de comillas
+                ++i;
+            }
+            continue;
+        }
+        if (c == '\'' || c == '"') { *quote = c; continue; }
+        if (c == '\\') {
+            if (i + 1 >= len && !final) break;  // escape partido entre bloques
+            ++i;
+            continue;
+        }
+        if (c != '\n' && c != ';') continue;
+        if (c == '\n' && i > start && buf[i - 1] == '\r')
+            buf[i - 1] = '\0';
+        buf[i] = '\0';
+        script_run_one(buf + start, args, st);
+        start = i + 1;
+    }
+    if (final && start < len && !shell_should_exit) {
+        buf[len] = '\0';
+        script_run_one(buf + start, args, st);
+        start = len;
+    }
+    *scan = i - start;
+    return start;
+}
+
+int loop_script(const char *path, const char *inline_cmds) {
+    shell_should_exit = false;
+    // Sin registro persistente: ni ensucia el historial interactivo ni
+    // cuesta un cerrojo y tres escrituras por comando
+    commands_init(false);
+    ficheros_init();
+    procesos_init();
+    // Salida totalmente bufferizada: solo se vacía antes de cada fork y al salir
+    setvbuf(stdout, NULL, _IOFBF, SCRIPT_CHUNK);
+
+    const char *name = inline_cmds ? "-c" : path;
+    int fd = -1;
+    if (!inline_cmds) {
+        fd = strcmp(path, "-") == 0 ? STDIN_FILENO : open(path, O_RDONLY);
+        if (fd == -1) {
+            fprintf(stderr, "p3: %s: %s\n", path, strerror(errno));
+            return 1;
+        }
+    }
+
+    tScriptStats st = {0, 0};
+    struct timespec t0, t1;
+    clock_gettime(CLOCK_MONOTONIC, &t0);
+
+    tArgs args;
+    args_init(&args);
+    size_t cap = SCRIPT_CHUNK + 1;
+    size_t len = 0;
+    if (inline_cmds) {
+        len = strlen(inline_cmds);
+        cap = len + 1;
+    }
+    char *buf = malloc(cap);
+    if (!buf) {
+        perror("malloc");
+        if (fd > STDIN_FILENO) close(fd);
+        return 1;
+    }
+    command_buffer = buf;
+    size_t scan = 0;
+    char quote = 0;
+    int status = 0;
+
+    if (inline_cmds) {
+        memcpy(buf, inline_cmds, len);
+        script_feed(buf, len, &scan, &quote, true, &args, &st);
+    } else {
+        bool eof = false;
+        while (!eof && !shell_should_exit) {
+            // Siempre cabe un bloque entero más el '\0' final
+            if (cap - len < SCRIPT_CHUNK + 1) {
+                char *nbuf = realloc(buf, len + SCRIPT_CHUNK + 1);
+                if (!nbuf) { perror("realloc"); status = 1; break; }
+                buf = nbuf;
+                command_buffer = buf;
+                cap = len + SCRIPT_CHUNK + 1;
+            }
+            ssize_t n = read(fd, buf + len, SCRIPT_CHUNK);
+            if (n < 0) {
+                if (errno == EINTR) continue;
+                fprintf(stderr, "p3: %s: %s\n", name, strerror(errno));
+                status = 1;
+                break;
+            }
+            eof = (n == 0);
+            len += (size_t)n;
+            size_t used = script_feed(buf, len, &scan, &quote, eof, &args,
+                                      &st);
+            memmove(buf, buf + used, len - used);
+            len -= used;
+        }
+        if (fd > STDIN_FILENO) close(fd);
+    }
+    if (quote && !shell_should_exit)
+        fprintf(stderr, "p3: %s: unterminated quote at end of input\n", name);
+
+    clock_gettime(CLOCK_MONOTONIC, &t1);
+    double secs = (double)(t1.tv_sec - t0.tv_sec) +
+                  (double)(t1.tv_nsec - t0.tv_nsec) / 1e9;
+    fflush(stdout);
+    fprintf(stderr, "p3: %s: %lu commands, %lu failed, %.3f s\n", name,
+            st.run, st.failed, secs);
+    args_free(&args);
+    shell_cleanup();
+    if (status == 0 && st.failed > 0) status = 1;
+    return status;
+}
+
 int cmd_authors(int argc, char *argv[])
 {
     (void)argc; (void)argv;
@@ -290,19 +462,18 @@ static char **find_entry_in_env_array(char **env, const char *name) {
     return NULL;
 }
 
-static int cmp_env_ptr(void *data, void *key) {
-    return (data == key) ? 0 : 1;
-}
-
 static void track_env_buffer(char *buf) {
     if (!buf) return;
-    if (!env_owned_buffers) env_owned_buffers = createList();
-    insertItem(env_owned_buffers, buf);
+    if (!env_owned_ready) {
+        hashmap_init(&env_owned_buffers, hash_ptr, eq_ptr);
+        env_owned_ready = true;
+    }
+    if (hashmap_put(&env_owned_buffers, buf, buf) != 0) perror("hashmap_put");
 }
 
 static void release_env_buffer_if_owned(char *buf) {
-    if (!env_owned_buffers || !buf) return;
-    deleteItem(env_owned_buffers, buf, cmp_env_ptr, free);
+    if (!env_owned_ready || !buf) return;
+    free(hashmap_remove(&env_owned_buffers, buf));
 }
 
 static int change_envvar_in_array(char **env, const char *varname, const
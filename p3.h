@@ -22,6 +22,10 @@ void prompt();
 // Función principal del shell
 void loop(char *env[]);
 
+// Modo no interactivo: ejecuta un fichero (o '-' para stdin) o una lista de
+// comandos separados por ';' sin prompt y con salida bufferizada
+int loop_script(const char *path, const char *inline_cmds);
+
 // Da información acerca de los autores del proyecto
 int cmd_authors(int argc, char *argv[]);
 
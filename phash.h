@@ -0,0 +1,23 @@
+// Pablo Araújo Rodríguez   pablo.araujo@udc.es
+// Uriel Liñares Vaamonde   uriel.linaresv@udc.es
+
+#ifndef PHASH_H
+#define PHASH_H
+
+#include <stdint.h>
+
+// FNV-1a de 32 bits con semilla y mezcla final; la comparten gen_phash y
+// el despachador para que el hash generado coincida con el de ejecución
+static inline uint32_t cmd_phash(const char *s, uint32_t seed) {
+    uint32_t h = 2166136261u ^ seed;
+    for (; *s; ++s) {
+        h ^= (unsigned char)*s;
+        h *= 16777619u;
+    }
+    h ^= h >> 15;
+    h *= 0x2c1b3c6du;
+    h ^= h >> 12;
+    return h;
+}
+
+#endif //PHASH_H
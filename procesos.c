@@ -1,15 +1,23 @@
 #define _GNU_SOURCE
 #define _POSIX_C_SOURCE 200809L
 #include "procesos.h"
+#include "ficheros.h"
 
-static List *background_processes = NULL;
+// Trabajos en segundo plano: vector contiguo de punteros, orden de lanzamiento
+static tVector background_processes;
+static bool background_ready = false;
 
 static void ensure_process_list(void) {
-    if (!background_processes) {
-        background_processes = createList();
+    if (!background_ready) {
+        vector_init(&background_processes, sizeof(ProcessInfo *));
+        background_ready = true;
     }
 }
 
+static ProcessInfo *job_at(size_t i) {
+    return *(ProcessInfo **)vector_at(&background_processes, i);
+}
+
 int cmd_fork(int argc, char *argv[]) {
     (void)argv;
     if (argc != 1) {
@@ -17,6 +25,9 @@ int cmd_fork(int argc, char *argv[]) {
         return 1;
     }
     pid_t pid;
+    // evita duplicar la salida pendiente en el hijo
+    fflush(stdout);
+    ficheros_flush_all();
     if ((pid = fork()) == 0){
         printf ("ejecutando proceso %d\n", getpid());
         exit(0); // Run atexit handlers to release allocations in the child
@@ -76,11 +87,10 @@ static void record_status_from_wait(ProcessInfo *info, int status) {
 }
 
 static void refresh_background_processes(void) {
-    if (!background_processes) return;
+    if (!background_ready) return;
     int status;
-    for (Node *node = background_processes->head; node != NULL;
-        node = node->next) {
-        ProcessInfo *info = (ProcessInfo *)node->data;
+    for (size_t i = 0; i < background_processes.len; ++i) {
+        ProcessInfo *info = job_at(i);
         if (!info) continue;
         pid_t res = waitpid(info->pid, &status,
                             WNOHANG | WUNTRACED | WCONTINUED);
@@ -120,7 +130,7 @@ static int add_background_process(pid_t pid, const char *cmdline,
     ensure_process_list();
     ProcessInfo *info = create_process_info(pid, cmdline, spec);
     if (!info) return -1;
-    if (insertItem(background_processes, info) != 0) {
+    if (!vector_push(&background_processes, &info)) {
         free(info);
         fprintf(stderr, "Unable to track process %d\n", pid);
         return -1;
@@ -134,20 +144,27 @@ static void destroy_process_info(void *data) {
     free(info);
 }
 
+static void clear_jobs(void) {
+    for (size_t i = 0; i < background_processes.len; ++i)
+        destroy_process_info(job_at(i));
+    vector_clear(&background_processes);
+}
+
 void procesos_init(void) {
     ensure_process_list();
-    clearList(background_processes, destroy_process_info);
+    clear_jobs();
 }
 
 void procesos_destroy(void) {
-    if (!background_processes) return;
-    deleteList(background_processes, destroy_process_info);
-    background_processes = NULL;
+    if (!background_ready) return;
+    clear_jobs();
+    vector_free(&background_processes);
+    background_ready = false;
 }
 
 void procesos_cleanup(void) {
-    if (!background_processes) return;
-    clearList(background_processes, destroy_process_info);
+    if (!background_ready) return;
+    clear_jobs();
 }
 
 void procesos_refresh(void) {
@@ -308,23 +325,16 @@ static void print_process(const ProcessInfo *info) {
 }
 
 static size_t remove_jobs_by_status(enum Status status) {
-    if (!background_processes) return 0;
-    size_t removed = 0;
-    Node *node = background_processes->head;
-    while (node) {
-        Node *next = node->next;
-        ProcessInfo *info = (ProcessInfo *)node->data;
-        if (info && info->status == status) {
-            if (node->prev) node->prev->next = node->next;
-            else background_processes->head = node->next;
-            if (node->next) node->next->prev = node->prev;
-            destroy_process_info(info);
-            free(node);
-            removed++;
-        }
-        node = next;
-    }
-    return removed;
+    if (!background_ready) return 0;
+    // Compactación estable en una sola pasada
+    size_t kept = 0, n = background_processes.len;
+    ProcessInfo **jobs = (ProcessInfo **)background_processes.data;
+    for (size_t i = 0; i < n; ++i) {
+        if (jobs[i] && jobs[i]->status == status) destroy_process_info(jobs[i]);
+        else jobs[kept++] = jobs[i];
+    }
+    background_processes.len = kept;
+    return n - kept;
 }
 
 static struct SEN sigstrnum[]={
@@ -478,6 +488,8 @@ int cmd_exec(int argc, char *argv[]) {
         fprintf(stderr, "%s: command not found\n", spec.argv[0]);
         return 127;
     }
+    fflush(stdout);
+    ficheros_flush_all();
     pid_t pid = fork();
     if (pid == -1) {
         perror("fork");
@@ -509,14 +521,13 @@ int cmd_jobs(int argc, char *argv[]) {
         return 1;
     }
     refresh_background_processes();
-    if (!background_processes || background_processes->head == NULL) {
+    if (!background_ready || background_processes.len == 0) {
         printf("No background jobs.\n");
         return 0;
     }
-    for (Node *node = background_processes->head; node; node = node->next) {
-        ProcessInfo *info = (ProcessInfo *)node->data;
-        print_process(info);
-    }
+    // Del más reciente al más antiguo
+    for (size_t i = background_processes.len; i-- > 0;)
+        print_process(job_at(i));
     return 0;
 }
 
@@ -550,6 +561,8 @@ int execute_external_command(int argc, char *argv[]) {
     }
     char command_line[MAX_COMMAND];
     build_command_line(command_line, sizeof command_line, argc, argv);
+    fflush(stdout);
+    ficheros_flush_all();
     pid_t pid = fork();
     if (pid == -1) {
         perror("fork");
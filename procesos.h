@@ -20,6 +20,7 @@
 #include "p3.h"
 #include "memoria.h"
 #include "lista.h"
+#include "contenedores.h"
 #define MAXVAR 1024
 
 void procesos_init(void);
@@ -0,0 +1,387 @@
+// Pablo Araújo Rodríguez   pablo.araujo@udc.es
+// Uriel Liñares Vaamonde   uriel.linaresv@udc.es
+
+#define _GNU_SOURCE
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/uio.h>
+#ifdef __linux__
+#include <sys/syscall.h>
+#endif
+#include "recorrido.h"
+#include "hilos.h"
+
+enum { NODE_PENDING, NODE_RUNNING, NODE_DONE };
+
+struct tWalkDir {
+    int fd;
+    atomic_int refs;
+};
+
+/* ---------------------------- Lector por lotes ---------------------------- */
+
+#ifdef __linux__
+// Formato de cada registro que devuelve getdents64
+struct linux_dirent64 {
+    uint64_t d_ino;
+    int64_t d_off;
+    unsigned short d_reclen;
+    unsigned char d_type;
+    char d_name[];
+};
+#endif
+
+int dreader_init(tDirReader *r, int fd) {
+    r->fd = fd;
+    r->len = r->pos = 0;
+    r->buf = NULL;
+    r->d = NULL;
+#ifdef __linux__
+    r->buf = malloc(DREADER_BUF);
+    if (!r->buf) { errno = ENOMEM; return -1; }
+#else
+    int dup_fd = dup(fd);
+    if (dup_fd == -1) return -1;
+    r->d = fdopendir(dup_fd);
+    if (!r->d) { close(dup_fd); return -1; }
+#endif
+    return 0;
+}
+
+static ent_type_t ent_type(unsigned char t) {
+    switch (t) {
+    case DT_UNKNOWN: return ENT_UNKNOWN;
+    case DT_REG: return ENT_REG;
+    case DT_DIR: return ENT_DIR;
+    case DT_LNK: return ENT_LNK;
+    default: return ENT_OTHER;
+    }
+}
+
+static bool is_dot_entry(const char *name) {
+    return name[0] == '.' &&
+           (name[1] == '\0' || (name[1] == '.' && name[2] == '\0'));
+}
+
+int dreader_next(tDirReader *r, tDirEntry *e) {
+#ifdef __linux__
+    for (;;) {
+        if (r->pos >= r->len) {
+            long n = syscall(SYS_getdents64, r->fd, r->buf, DREADER_BUF);
+            if (n < 0) return -1;
+            if (n == 0) return 0;
+            r->len = (size_t)n;
+            r->pos = 0;
+        }
+        struct linux_dirent64 *d = (struct linux_dirent64 *)(r->buf + r->pos);
+        r->pos += d->d_reclen;
+        if (is_dot_entry(d->d_name)) continue;
+        e->name = d->d_name;
+        e->type = ent_type(d->d_type);
+        e->ino = (ino_t)d->d_ino;
+        return 1;
+    }
+#else
+    for (;;) {
+        errno = 0;
+        struct dirent *de = readdir(r->d);
+        if (!de) return errno ? -1 : 0;
+        if (is_dot_entry(de->d_name)) continue;
+        e->name = de->d_name;
+        e->type = ent_type(de->d_type);
+        e->ino = de->d_ino;
+        return 1;
+    }
+#endif
+}
+
+void dreader_free(tDirReader *r) {
+    free(r->buf);
+    r->buf = NULL;
+    if (r->d) closedir(r->d);
+    r->d = NULL;
+}
+
+/* ---------------------------- Recorrido ---------------------------- */
+
+struct tWalk {
+    const tWalkOpts *opts;
+    tExecutor *ex;
+    pthread_mutex_t lock;
+    pthread_cond_t done_cv;
+    tWalkNode *waiting;     // nodo por el que espera el emisor
+};
+
+static void dir_release(tWalkDir *d) {
+    if (!d || atomic_fetch_sub(&d->refs, 1) != 1) return;
+    close(d->fd);
+    free(d);
+}
+
+static tWalkDir *dir_retain(tWalkDir *d) {
+    if (d) atomic_fetch_add(&d->refs, 1);
+    return d;
+}
+
+static tWalkNode *node_new(tWalk *w, char *path, int depth, int refs) {
+    tWalkNode *n = calloc(1, sizeof *n);
+    if (!n) return NULL;
+    n->path = path;
+    const char *slash = strrchr(path, '/');
+    n->name = (slash && slash[1]) ? slash + 1 : path;
+    n->depth = depth;
+    n->walk = w;
+    strbuf_init(&n->out);
+    strbuf_init(&n->err);
+    atomic_init(&n->state, NODE_PENDING);
+    atomic_init(&n->refs, refs);
+    return n;
+}
+
+// Cada nodo lo referencian el árbol y, si se encoló, su tarea
+static void node_release(tWalkNode *n) {
+    if (atomic_fetch_sub(&n->refs, 1) != 1) return;
+    dir_release(n->parent_dir);
+    dir_release(n->dir);
+    free(n->path);
+    free(n->data);
+    strbuf_free(&n->out);
+    strbuf_free(&n->err);
+    free(n->children);
+    free(n);
+}
+
+static bool node_claim(tWalkNode *n) {
+    int expected = NODE_PENDING;
+    return atomic_compare_exchange_strong(&n->state, &expected, NODE_RUNNING);
+}
+
+int walk_open(tWalkNode *n) {
+    if (n->dir) return n->dir->fd;
+    const int flags = O_RDONLY | O_DIRECTORY | O_CLOEXEC;
+    int fd = -1;
+    if (n->parent_dir) {
+        fd = openat(n->parent_dir->fd, n->name, flags | O_NOFOLLOW);
+        // Sin descriptores libres el padre no ayuda: probamos por ruta
+        if (fd == -1 && errno != EMFILE && errno != ENFILE) goto out;
+    }
+    if (fd == -1) fd = open(n->path, flags);
+out:
+    // El padre ya no hace falta para este nodo
+    dir_release(n->parent_dir);
+    n->parent_dir = NULL;
+    if (fd == -1) return -1;
+    tWalkDir *d = malloc(sizeof *d);
+    if (!d) {
+        close(fd);
+        errno = ENOMEM;
+        return -1;
+    }
+    d->fd = fd;
+    atomic_init(&d->refs, 1);
+    n->dir = d;
+    return fd;
+}
+
+static void node_process(tWalk *w, tWalkNode *n) {
+    n->status |= w->opts->scan(w, n, w->opts->ctx);
+    // Los hijos que aún no se han abierto conservan su referencia
+    dir_release(n->dir);
+    n->dir = NULL;
+    dir_release(n->parent_dir);
+    n->parent_dir = NULL;
+    pthread_mutex_lock(&w->lock);
+    atomic_store(&n->state, NODE_DONE);
+    if (w->waiting == n) pthread_cond_signal(&w->done_cv);
+    pthread_mutex_unlock(&w->lock);
+}
+
+static void node_task(void *arg) {
+    tWalkNode *n = arg;
+    // Puede que el emisor ya lo haya procesado en línea
+    if (node_claim(n)) node_process(n->walk, n);
+    node_release(n);
+}
+
+static void submit(tWalk *w, tWalkNode *n) {
+    atomic_fetch_add(&n->refs, 1);
+    if (executor_submit(w->ex, node_task, n) != 0)
+        atomic_fetch_sub(&n->refs, 1);  // lo procesará el emisor
+}
+
+tWalkNode *walk_add_child(tWalk *w, tWalkNode *parent, const char *name) {
+    if (parent->nchildren == parent->children_cap) {
+        size_t ncap = parent->children_cap ? parent->children_cap * 2 : 8;
+        tWalkNode **nc = realloc(parent->children, ncap * sizeof *nc);
+        if (!nc) return NULL;
+        parent->children = nc;
+        parent->children_cap = ncap;
+    }
+    size_t lp = strlen(parent->path), ln = strlen(name);
+    char *path = malloc(lp + ln + 2);
+    if (!path) return NULL;
+    memcpy(path, parent->path, lp);
+    path[lp] = '/';
+    memcpy(path + lp + 1, name, ln + 1);
+    tWalkNode *n = node_new(w, path, parent->depth + 1, 1);
+    if (!n) { free(path); return NULL; }
+    n->name = path + lp + 1;
+    n->parent_dir = dir_retain(parent->dir);
+    n->parent = parent;
+    parent->children[parent->nchildren++] = n;
+    if (w->ex) submit(w, n);
+    return n;
+}
+
+// Deja n procesado: lo hace en línea si nadie lo ha cogido, si no espera
+static void node_wait(tWalk *w, tWalkNode *n) {
+    if (node_claim(n)) { node_process(w, n); return; }
+    if (atomic_load(&n->state) == NODE_DONE) return;
+    pthread_mutex_lock(&w->lock);
+    w->waiting = n;
+    while (atomic_load(&n->state) != NODE_DONE)
+        pthread_cond_wait(&w->done_cv, &w->lock);
+    w->waiting = NULL;
+    pthread_mutex_unlock(&w->lock);
+}
+
+/* Salida del emisor: los buffers de los nodos ya emitidos se guardan y se
+ * escriben juntos con writev() al llegar a EMIT_BATCH bytes, en vez de
+ * pasar cada uno por stdio */
+#define EMIT_BATCH (1024 * 1024)
+
+typedef struct {
+    const tWalkOpts *opts;
+    tVector bufs;       // tStrBuf pendientes, ya sacados de sus nodos
+    size_t bytes;
+} tEmitter;
+
+static void write_all_iov(int fd, struct iovec *iov, int cnt) {
+    while (cnt > 0) {
+        ssize_t w = writev(fd, iov, cnt);
+        if (w < 0) {
+            if (errno == EINTR) continue;
+            return;     // igual que stdio: se pierde la salida
+        }
+        size_t left = (size_t)w;
+        while (cnt > 0 && left >= iov->iov_len) {
+            left -= iov->iov_len;
+            ++iov; --cnt;
+        }
+        if (cnt > 0) {
+            iov->iov_base = (char *)iov->iov_base + left;
+            iov->iov_len -= left;
+        }
+    }
+}
+
+static void emitter_flush(tEmitter *e) {
+    if (e->bufs.len == 0) return;
+    // Lo que ya hubiera en stdout va antes
+    fflush(stdout);
+    int fd = fileno(stdout);
+    struct iovec iov[64];
+    size_t i = 0;
+    while (i < e->bufs.len) {
+        int cnt = 0;
+        for (; i < e->bufs.len && cnt < 64 && cnt < IOV_MAX; ++i, ++cnt) {
+            tStrBuf *b = vector_at(&e->bufs, i);
+            iov[cnt].iov_base = b->data;
+            iov[cnt].iov_len = b->len;
+        }
+        write_all_iov(fd, iov, cnt);
+    }
+    for (i = 0; i < e->bufs.len; ++i) strbuf_free(vector_at(&e->bufs, i));
+    vector_clear(&e->bufs);
+    e->bytes = 0;
+}
+
+static void node_emit(tEmitter *e, tWalkNode *n) {
+    if (e->opts->emit) e->opts->emit(n, e->opts->ctx);
+    if (n->out.len) {
+        if (vector_push(&e->bufs, &n->out)) {
+            e->bytes += n->out.len;
+            strbuf_init(&n->out);
+        } else {
+            emitter_flush(e);
+            fwrite(n->out.data, 1, n->out.len, stdout);
+        }
+        if (e->bytes >= EMIT_BATCH) emitter_flush(e);
+    }
+    if (n->err.len) {
+        emitter_flush(e);
+        fflush(stdout);
+        fwrite(n->err.data, 1, n->err.len, stderr);
+    }
+    strbuf_free(&n->out);
+    strbuf_free(&n->err);
+}
+
+typedef struct {
+    tWalkNode *node;
+    size_t next;
+} tFrame;
+
+int walk_run(const char *root, const tWalkOpts *o) {
+    tWalk w = { o, NULL, PTHREAD_MUTEX_INITIALIZER, PTHREAD_COND_INITIALIZER,
+                NULL };
+    char *path = strdup(root);
+    tWalkNode *top = path ? node_new(&w, path, 0, 1) : NULL;
+    if (!top) { free(path); perror("walk"); return 1; }
+
+    // La raíz se procesa aquí; los hilos solo se arrancan si hay subárbol
+    node_process(&w, top);
+    int threads = o->threads > 0 ? o->threads : hilos_online();
+    if (threads > 1 && top->nchildren > 0) {
+        w.ex = executor_create(threads - 1);
+        for (size_t i = 0; w.ex && i < top->nchildren; ++i)
+            submit(&w, top->children[i]);
+    }
+
+    int status = 0;
+    tVector stack;
+    vector_init(&stack, sizeof(tFrame));
+    tFrame f0 = { top, 0 };
+    if (!vector_push(&stack, &f0)) {
+        perror("walk");
+        status = 1;
+        node_release(top);
+    }
+    tEmitter em = { o, { 0 }, 0 };
+    vector_init(&em.bufs, sizeof(tStrBuf));
+    if (o->order == WALK_PREORDER && stack.len) node_emit(&em, top);
+    while (stack.len) {
+        tFrame *f = vector_at(&stack, stack.len - 1);
+        tWalkNode *n = f->node;
+        if (f->next < n->nchildren) {
+            tWalkNode *c = n->children[f->next++];
+            node_wait(&w, c);
+            if (o->order == WALK_PREORDER) node_emit(&em, c);
+            tFrame fc = { c, 0 };
+            if (!vector_push(&stack, &fc)) {
+                // Sin memoria para seguir bajando: se omite el subárbol
+                perror("walk");
+                status = 1;
+                node_release(c);
+            }
+            continue;
+        }
+        if (o->order == WALK_POSTORDER) node_emit(&em, n);
+        status |= n->status;
+        vector_pop(&stack);
+        node_release(n);
+    }
+    emitter_flush(&em);
+    vector_free(&em.bufs);
+    vector_free(&stack);
+    executor_destroy(w.ex);
+    pthread_mutex_destroy(&w.lock);
+    pthread_cond_destroy(&w.done_cv);
+    return status;
+}
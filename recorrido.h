@@ -0,0 +1,103 @@
+// Pablo Araújo Rodríguez   pablo.araujo@udc.es
+// Uriel Liñares Vaamonde   uriel.linaresv@udc.es
+
+#ifndef RECORRIDO_H
+#define RECORRIDO_H
+
+#include <dirent.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <sys/types.h>
+#include "contenedores.h"
+
+/* Lector de directorios por lotes: en Linux pide las entradas con
+ * getdents64 en bloques de DREADER_BUF bytes y devuelve el d_type, para
+ * que quien llama solo haga fstatat() si el tipo es desconocido o
+ * necesita los metadatos. En otros sistemas usa readdir(). */
+#define DREADER_BUF (32 * 1024)
+
+// Tipo de entrada según d_type (ENT_UNKNOWN si el FS no lo da)
+typedef enum { ENT_UNKNOWN, ENT_REG, ENT_DIR, ENT_LNK, ENT_OTHER } ent_type_t;
+
+typedef struct {
+    const char *name;
+    ent_type_t type;
+    ino_t ino;
+} tDirEntry;
+
+typedef struct {
+    int fd;                 // no es propiedad del lector
+    char *buf;
+    size_t len;
+    size_t pos;
+    DIR *d;                 // solo sin getdents64
+} tDirReader;
+
+int dreader_init(tDirReader *r, int fd);
+// 1 si hay entrada (sin "." ni ".."), 0 al final, -1 si falla (errno)
+int dreader_next(tDirReader *r, tDirEntry *e);
+void dreader_free(tDirReader *r);
+
+/* Recorrido paralelo de árboles de directorios.
+ * Cada directorio es un nodo que procesa un hilo cualquiera: la función
+ * scan lee el directorio, deja su salida en el buffer del nodo y registra
+ * los subdirectorios con walk_add_child, que se encolan para los demás
+ * hilos. El hilo que llama a walk_run emite los buffers en preorden o en
+ * postorden, así que la salida no depende del reparto entre hilos; si el
+ * siguiente nodo a emitir no lo ha cogido nadie, lo procesa él mismo. */
+
+typedef struct tWalk tWalk;
+// Directorio abierto compartido con los hijos mientras lo necesiten
+typedef struct tWalkDir tWalkDir;
+
+typedef struct tWalkNode {
+    char *path;                     // solo para mostrar y para mensajes
+    const char *name;               // último componente de path
+    tWalkDir *parent_dir;           // los hijos se abren relativos a él
+    tWalkDir *dir;                  // abierto por walk_opendir
+    int depth;
+    int status;                     // != 0 si hubo errores en el nodo
+    tStrBuf out;                    // salida para stdout
+    tStrBuf err;                    // mensajes para stderr
+    struct tWalkNode **children;    // en orden de emisión
+    size_t nchildren;
+    size_t children_cap;
+    struct tWalkNode *parent;       // NULL en la raíz
+    void *data;                     // libre para scan; se libera con free()
+    tWalk *walk;
+    atomic_int state;
+    atomic_int refs;
+} tWalkNode;
+
+// Procesa el directorio n (desde cualquier hilo); devuelve 0 o 1 si falla
+typedef int (*walk_scan_fn)(tWalk *w, tWalkNode *n, void *ctx);
+
+/* Se llama en el hilo emisor justo antes de escribir la salida de n; en
+ * postorden, los hijos ya han pasado por aquí (para acumular en el padre) */
+typedef void (*walk_emit_fn)(tWalkNode *n, void *ctx);
+
+typedef enum { WALK_PREORDER, WALK_POSTORDER } walk_order_t;
+
+typedef struct {
+    walk_scan_fn scan;
+    walk_emit_fn emit;  // opcional
+    void *ctx;
+    walk_order_t order;
+    int threads;        // hilos en total (<= 0: uno por CPU)
+} tWalkOpts;
+
+// Recorre el árbol que cuelga de root; devuelve 0 o 1 si algún nodo falló
+int walk_run(const char *root, const tWalkOpts *o);
+
+/* Abre el directorio del nodo con openat() sobre el descriptor del padre,
+ * sin volver a resolver la ruta completa, y devuelve su descriptor. Las
+ * entradas se leen con un tDirReader y se consultan con fstatat() o
+ * readlinkat() sobre él. Se cierra cuando el nodo y todos sus hijos lo
+ * han soltado. */
+int walk_open(tWalkNode *n);
+
+// Añade parent/name como hijo de parent y lo encola (NULL si no hay memoria)
+tWalkNode *walk_add_child(tWalk *w, tWalkNode *parent, const char *name);
+
+#endif //RECORRIDO_H
@@ -0,0 +1,152 @@
+// Pablo Araújo Rodríguez   pablo.araujo@udc.es
+// Uriel Liñares Vaamonde   uriel.linaresv@udc.es
+
+#define _GNU_SOURCE
+#include <errno.h>
+#include <string.h>
+#include <unistd.h>
+#include "uring.h"
+
+#if URING_AVAILABLE
+#include <sys/mman.h>
+#include <sys/syscall.h>
+
+static int sys_setup(unsigned entries, struct io_uring_params *p) {
+    return (int)syscall(__NR_io_uring_setup, entries, p);
+}
+
+static int sys_enter(int fd, unsigned to_submit, unsigned min_complete,
+                     unsigned flags) {
+    return (int)syscall(__NR_io_uring_enter, fd, to_submit, min_complete,
+                        flags, NULL, 0);
+}
+
+int uring_init(tUring *r, unsigned entries) {
+    memset(r, 0, sizeof *r);
+    r->fd = -1;
+    struct io_uring_params p;
+    memset(&p, 0, sizeof p);
+    int fd = sys_setup(entries, &p);
+    if (fd < 0) return -1;
+    r->fd = fd;
+    r->features = p.features;
+    r->sq_ring_sz = p.sq_off.array + p.sq_entries * sizeof(unsigned);
+    r->cq_ring_sz = p.cq_off.cqes + p.cq_entries * sizeof(struct io_uring_cqe);
+    bool single = p.features & IORING_FEAT_SINGLE_MMAP;
+    if (single && r->cq_ring_sz > r->sq_ring_sz) r->sq_ring_sz = r->cq_ring_sz;
+
+    r->sq_ring = mmap(NULL, r->sq_ring_sz, PROT_READ | PROT_WRITE,
+                      MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQ_RING);
+    if (r->sq_ring == MAP_FAILED) goto fail;
+    if (single) {
+        r->cq_ring = r->sq_ring;
+    } else {
+        r->cq_ring = mmap(NULL, r->cq_ring_sz, PROT_READ | PROT_WRITE,
+                          MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_CQ_RING);
+        if (r->cq_ring == MAP_FAILED) { r->cq_ring = NULL; goto fail; }
+    }
+    r->sqes_sz = p.sq_entries * sizeof(struct io_uring_sqe);
+    r->sqes = mmap(NULL, r->sqes_sz, PROT_READ | PROT_WRITE,
+                   MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQES);
+    if (r->sqes == MAP_FAILED) { r->sqes = NULL; goto fail; }
+
+    char *sq = r->sq_ring, *cq = r->cq_ring;
+    r->sq_head = (unsigned *)(sq + p.sq_off.head);
+    r->sq_tail = (unsigned *)(sq + p.sq_off.tail);
+    r->sq_mask = (unsigned *)(sq + p.sq_off.ring_mask);
+    r->sq_array = (unsigned *)(sq + p.sq_off.array);
+    r->sq_entries = p.sq_entries;
+    r->sq_local_tail = *r->sq_tail;
+    r->cq_head = (unsigned *)(cq + p.cq_off.head);
+    r->cq_tail = (unsigned *)(cq + p.cq_off.tail);
+    r->cq_mask = (unsigned *)(cq + p.cq_off.ring_mask);
+    r->cqes = (struct io_uring_cqe *)(cq + p.cq_off.cqes);
+    return 0;
+fail:;
+    int e = errno;
+    uring_free(r);
+    errno = e;
+    return -1;
+}
+
+void uring_free(tUring *r) {
+    if (r->sqes) munmap(r->sqes, r->sqes_sz);
+    if (r->cq_ring && r->cq_ring != r->sq_ring) munmap(r->cq_ring, r->cq_ring_sz);
+    if (r->sq_ring && r->sq_ring != MAP_FAILED) munmap(r->sq_ring, r->sq_ring_sz);
+    if (r->fd >= 0) close(r->fd);
+    memset(r, 0, sizeof *r);
+    r->fd = -1;
+}
+
+unsigned uring_sq_space(const tUring *r) {
+    unsigned head = __atomic_load_n(r->sq_head, __ATOMIC_ACQUIRE);
+    return r->sq_entries - (r->sq_local_tail - head);
+}
+
+struct io_uring_sqe *uring_get_sqe(tUring *r) {
+    if (uring_sq_space(r) == 0) return NULL;
+    unsigned idx = r->sq_local_tail & *r->sq_mask;
+    struct io_uring_sqe *sqe = &r->sqes[idx];
+    memset(sqe, 0, sizeof *sqe);
+    r->sq_array[idx] = idx;
+    r->sq_local_tail++;
+    return sqe;
+}
+
+int uring_submit(tUring *r, unsigned wait_nr) {
+    unsigned tail = *r->sq_tail;
+    unsigned to_submit = r->sq_local_tail - tail;
+    // Los SQE deben ser visibles antes que la nueva cola
+    __atomic_store_n(r->sq_tail, r->sq_local_tail, __ATOMIC_RELEASE);
+    unsigned flags = wait_nr ? IORING_ENTER_GETEVENTS : 0;
+    if (!to_submit && !wait_nr) return 0;
+    int rc;
+    do rc = sys_enter(r->fd, to_submit, wait_nr, flags);
+    while (rc < 0 && errno == EINTR);
+    return rc;
+}
+
+int uring_wait(tUring *r, unsigned wait_nr) {
+    int rc;
+    do rc = sys_enter(r->fd, 0, wait_nr, IORING_ENTER_GETEVENTS);
+    while (rc < 0 && errno == EINTR);
+    return rc;
+}
+
+struct io_uring_cqe *uring_peek_cqe(tUring *r) {
+    unsigned head = *r->cq_head;
+    if (head == __atomic_load_n(r->cq_tail, __ATOMIC_ACQUIRE)) return NULL;
+    return &r->cqes[head & *r->cq_mask];
+}
+
+void uring_cqe_seen(tUring *r) {
+    __atomic_store_n(r->cq_head, *r->cq_head + 1, __ATOMIC_RELEASE);
+}
+
+#else
+
+int uring_init(tUring *r, unsigned entries) {
+    (void)entries;
+    memset(r, 0, sizeof *r);
+    r->fd = -1;
+    errno = ENOSYS;
+    return -1;
+}
+
+void uring_free(tUring *r) { (void)r; }
+struct io_uring_sqe *uring_get_sqe(tUring *r) { (void)r; return NULL; }
+int uring_submit(tUring *r, unsigned wait_nr) {
+    (void)r; (void)wait_nr;
+    errno = ENOSYS;
+    return -1;
+}
+int uring_wait(tUring *r, unsigned wait_nr) {
+    (void)r; (void)wait_nr;
+    errno = ENOSYS;
+    return -1;
+}
+struct io_uring_cqe *uring_peek_cqe(tUring *r) { (void)r; return NULL; }
+void uring_cqe_seen(tUring *r) { (void)r; }
+unsigned uring_sq_space(const tUring *r) { (void)r; return 0; }
+
+#endif
@@ -0,0 +1,60 @@
+// Pablo Araújo Rodríguez   pablo.araujo@udc.es
+// Uriel Liñares Vaamonde   uriel.linaresv@udc.es
+
+#ifndef URING_H
+#define URING_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+/* Envoltorio mínimo de io_uring sobre las llamadas al sistema, sin
+ * liburing: un anillo de envío (SQ) y uno de finalización (CQ)
+ * proyectados con mmap. Solo Linux; en el resto uring_init falla con
+ * ENOSYS y quien llama usa su camino síncrono. */
+
+#ifdef __linux__
+#include <linux/io_uring.h>
+#define URING_AVAILABLE 1
+#else
+struct io_uring_sqe;
+struct io_uring_cqe;
+#define URING_AVAILABLE 0
+#endif
+
+typedef struct {
+    int fd;
+    unsigned features;          // IORING_FEAT_* del kernel
+    unsigned sq_entries;
+    unsigned *sq_head;
+    unsigned *sq_tail;
+    unsigned *sq_mask;
+    unsigned *sq_array;
+    unsigned sq_local_tail;     // SQE preparados aún sin publicar
+    unsigned *cq_head;
+    unsigned *cq_tail;
+    unsigned *cq_mask;
+    struct io_uring_sqe *sqes;
+    struct io_uring_cqe *cqes;
+    void *sq_ring;
+    size_t sq_ring_sz;
+    void *cq_ring;              // igual a sq_ring con IORING_FEAT_SINGLE_MMAP
+    size_t cq_ring_sz;
+    size_t sqes_sz;
+} tUring;
+
+int uring_init(tUring *r, unsigned entries);
+void uring_free(tUring *r);
+// Siguiente SQE libre, ya a cero (NULL si el anillo de envío está lleno)
+struct io_uring_sqe *uring_get_sqe(tUring *r);
+// Publica los SQE preparados y espera al menos wait_nr finalizaciones
+int uring_submit(tUring *r, unsigned wait_nr);
+/* Solo espera wait_nr finalizaciones, sin tocar el anillo de envío: la
+ * puede llamar un hilo mientras otro prepara y publica SQE */
+int uring_wait(tUring *r, unsigned wait_nr);
+// Finalización pendiente o NULL; uring_cqe_seen la da por consumida
+struct io_uring_cqe *uring_peek_cqe(tUring *r);
+void uring_cqe_seen(tUring *r);
+// Huecos libres en el anillo de envío
+unsigned uring_sq_space(const tUring *r);
+
+#endif //URING_H